@@ -18,6 +18,12 @@ MODULE_DESCRIPTION("BLOCK-LEVEL DATA MANAGAMENT SERVICE");
 
 unsigned long the_syscall_table = 0x0;
 module_param(the_syscall_table, ulong, 0660);
+
+// writeback parameters (extern in utils_header.h)
+unsigned int wb_interval_ms = 5000;     // intervallo tra due risvegli del thread di writeback
+module_param(wb_interval_ms, uint, 0660);
+unsigned int wb_dirty_threshold = 64;   // blocchi dirty che anticipano il risveglio (0 per disabilitare)
+module_param(wb_dirty_threshold, uint, 0660);
 unsigned long the_ni_syscall;
 unsigned long new_sys_call_array[] = {0x0,0x0,0x0};
 #define HACKED_ENTRIES (int)(sizeof(new_sys_call_array)/sizeof(unsigned long))
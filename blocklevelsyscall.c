@@ -1,76 +1,45 @@
+#include <linux/bitmap.h>
+#include <linux/buffer_head.h>
 #include <linux/fs.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/slab.h>
 #include <linux/srcu.h>
 #include <linux/syscalls.h>
+#include <linux/timekeeping.h>
 #include <linux/types.h>
+#include <linux/uaccess.h>
 
 #include "utils_header.h"
 
-// put_data syscall - insert size byte of the source in a free block
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,17,0)
-__SYSCALL_DEFINEx(2, _put_data, char*, source, size_t, size) {
-#else
-asmlinkage int sys_put_data(char* source, size_t size) {
-#endif
+// inserisce al più size byte del buffer source (utente oppure, se user è 0, kernel) in un blocco libero in coda al
+// canale chan (il chiamante ha già incrementato il contatore degli utilizzi e controllato i parametri)
+static int put_data_buf(struct super_block *sb, unsigned int chan, char *source, size_t size, int user, int async, uint64_t *seq) {
 
-    int i;
+    int i = -1;
     int ret;
-    int len;
+    size_t left;
+    char *data;
+    struct buffer_head *bh = NULL;
     int new_first_valid;
-    char *klvl_buf;
-    struct bdev_layout *bdev_blk;
+    unsigned int last_valid;
+    unsigned int mode = COMMIT_SYNC;
+    uint64_t op_seq = 0;
+    uint64_t msg_seq;
+    uint64_t old_seq;
+    int64_t msg_time;
+    int64_t old_time;
+    unsigned int old_chan;
+    size_t copied;
     struct onefilefs_sb_info *sb_disk;
 
-    printk("%s: [put_data()] - invocata\n", MODNAME);
-
-    // incremento del contatore atomico degli utilizzi del file system
-    atomic_fetch_add(1, &(fs_info.usage));
-
-    // sanity checks
-    if (!fs_info.mounted) { // controlla se il file system è montato
-        printk(KERN_INFO "%s: [put_data()] - il file system non è montato\n", MODNAME);
-        atomic_fetch_add(-1, &(fs_info.usage));
-        return -ENODEV;
-    }  
-    if (source == NULL) {
-        printk(KERN_INFO "%s: [put_data()] - source null\n", MODNAME);
-        atomic_fetch_add(-1, &(fs_info.usage));
-        return -EINVAL;
-    }
-    len = strlen(source);
-    if (len == 0) {
-        printk(KERN_INFO "%s: [put_data()] - non vi sono dati da scrivere\n", MODNAME);
-        atomic_fetch_add(-1, &(fs_info.usage));
-        return -EINVAL;
-    }
-    if (size >= DATA_SIZE) {
-        printk(KERN_INFO "%s: [put_data()] - dimensione dei dati da scrivere maggiore del limite massimo memorizzabile in un blocco\n", MODNAME);
-        atomic_fetch_add(-1, &(fs_info.usage));
-        return -EINVAL;
-    }
-    
-    // allocazione di memoria dinamica per contenere il messaggio utente
-    klvl_buf = kmalloc(size+1, GFP_KERNEL);
-    if (!klvl_buf) {
-        printk(KERN_CRIT "%s: [put_data()] - impossibile allocare memoria per la ricezione del buffer utente\n", MODNAME);
-        atomic_fetch_add(-1, &(fs_info.usage));
-        return -ENOMEM;
-    }
-
-    // copia size bytes dal buffer utente al buffer kernel
-    ret = copy_from_user(klvl_buf, source, size);
-    len = strlen(klvl_buf);
-    if (len < size) size = len;
-    printk(KERN_INFO "%s: [put_data()] - messaggio da inserire: %s (len=%lu)\n", MODNAME, klvl_buf, size+1); 
-
     // prendo il lock per sincronizzare gli scrittori (no concorrenza su tutte le operazioni di scrittura fino al rilascio del lock)
-    mutex_lock(&(fs_info.write_lock));
+    mutex_lock(&(FS_INFO(sb)->write_lock));
 
     // recupero del superblocco
-    sb_disk = get_sb_info(global_sb);
+    sb_disk = get_sb_info(sb);
     if (sb_disk == NULL) {
         printk(KERN_CRIT "%s: [put_data()] - errore durante il recupero del superblocco\n", MODNAME);
         ret = -EIO;
@@ -78,188 +47,397 @@ asmlinkage int sys_put_data(char* source, size_t size) {
     }
     
     // ricerca di un blocco libero
-    for (i = 0; i < NBLOCKS-2; i++) {
-        bdev_blk = get_block(global_sb, blk_offset(i));
-        if (bdev_blk == NULL) {
-            printk(KERN_CRIT "%s: [put_data()] - errore durante il recupero del blocco %d\n", MODNAME, i);
-            ret = -EIO;
-            goto put_exit;
-        }
-
-        if (!get_validity(bdev_blk->next_block)) // cerco un blocco libero (bit di validità = 0)
-            break;
+    i = get_free_block(sb);
+    if (i == -EIO) {
+        printk(KERN_CRIT "%s: [put_data()] - errore durante la ricerca di un blocco libero\n", MODNAME);
+        ret = -EIO;
+        goto put_exit;
     }
-    
-    // se il ciclo for è stato completato significa che non ci sono blocchi liberi
-    if (i >= NBLOCKS-2) {
-        printk(KERN_INFO "%s: [put_data()] - nessun blocco disponibile per inserire il messaggio\n", MODNAME);
+    if (i < 0) {
+        LOG printk(KERN_INFO "%s: [put_data()] - nessun blocco disponibile per inserire il messaggio\n", MODNAME);
         ret = -ENOMEM;
         goto put_exit;
     }
 
-    printk(KERN_INFO "%s: [put_data()] - blocco libero: %d\n", MODNAME, i);
+    LOG printk(KERN_INFO "%s: [put_data()] - blocco libero: %d\n", MODNAME, i);
 
-    // attesa della fine del grace period
-    synchronize_srcu(&(fs_info.srcu));
+    // nessuna attesa del grace period: i lettori hanno già abbandonato il blocco libero durante la sua invalidazione
 
-    // aggiorna il campo next_block del vecchio ultimo blocco valido (se presente)
-    if (sb_disk->last_valid != -1) {
-        // aggiorna il blocco successivo a cui punta il last_valid corrente
-        ret = set_block_metadata_valid(global_sb, blk_offset(sb_disk->last_valid), i);
-        if (ret < 0) {
-            printk(KERN_CRIT "%s: [put_data()] - errore durante la scrittura dei metadati sul blocco %d\n", MODNAME, sb_disk->last_valid);
-            ret = -EIO;
-            goto put_exit;
+    // il messaggio viene copiato direttamente nel buffer del blocco libero (ancora fuori dalla catena), senza buffer
+    // intermedi; il messaggio termina al primo '\0' oppure all'ultimo byte copiato
+    bh = bread_block(sb, blk_offset(i));
+    if (bh == NULL) {
+        printk(KERN_CRIT "%s: [put_data()] - errore durante il recupero del blocco %d\n", MODNAME, i);
+        ret = -EIO;
+        goto put_exit;
+    }
+    // in caso di errore prima della scrittura del blocco i byte copiati vengono azzerati (il blocco resta libero)
+    data = ((struct bdev_layout *) bh->b_data)->data;
+    copied = size;
+    if (user) {
+        left = copy_from_user(data, source, size);
+        if (left == size) {
+            ret = -EFAULT;
+            goto put_clear;
         }
+        size -= left;
+    }
+    else {
+        memcpy(data, source, size);
+    }
+    size = strnlen(data, size);
+    if (size == 0) {
+        LOG printk(KERN_INFO "%s: [put_data()] - non vi sono dati da scrivere\n", MODNAME);
+        ret = -EINVAL;
+        goto put_clear;
+    }
+    LOG printk(KERN_INFO "%s: [put_data()] - messaggio da inserire: %.*s (len=%zu)\n", MODNAME, (int) size, data, size);
+
+    // voce dell'indice dei messaggi, riservata prima di modificare lo stato condiviso e riempita dopo il collegamento
+    msg_seq = FS_INFO(sb)->msg_seq + 1;
+    ret = index_reserve(sb, msg_seq);
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: [put_data()] - impossibile aggiornare l'indice dei messaggi\n", MODNAME);
+        ret = -ENOMEM;
+        goto put_clear;
     }
 
-    // scrivi i dati sul blocco specifico
-    ret = set_block_data(global_sb, blk_offset(i), klvl_buf, size);
+    // numero di sequenza e istante di inserimento (non decrescente) del messaggio, resi visibili ai lettori solo
+    // dopo il collegamento alla catena (assegnati prima che il blocco torni valido, così un cursore non associa
+    // il blocco al messaggio precedente); i valori precedenti vengono ripristinati se l'inserimento fallisce
+    msg_time = max_t(int64_t, ktime_get_real_ns(), FS_INFO(sb)->msg_time);
+    old_seq = FS_INFO(sb)->block_seq[i];
+    old_time = FS_INFO(sb)->block_time[i];
+    old_chan = FS_INFO(sb)->block_chan[i];
+    WRITE_ONCE(FS_INFO(sb)->block_seq[i], msg_seq);
+    WRITE_ONCE(FS_INFO(sb)->block_time[i], msg_time);
+    WRITE_ONCE(FS_INFO(sb)->block_chan[i], chan);
+
+    // scrivi i dati sul blocco specifico (ancora fuori dalla catena dei blocchi validi)
+    ret = set_block_data(sb, blk_offset(i), data, size, msg_seq, msg_time, 0);
     if (ret < 0) {
         printk(KERN_CRIT "%s: [put_data()] - errore durante la scrittura dei dati sul blocco %d\n", MODNAME, i);
         ret = -EIO;
-        goto put_exit;
+        goto put_undo;
+    }
+
+    // aggiorna il campo next_block del vecchio ultimo blocco valido del canale (se presente)
+    last_valid = chan_last_valid(sb_disk, chan);
+    if (last_valid != -1) {
+        // aggiorna il blocco successivo a cui punta il last_valid corrente
+        ret = set_block_metadata_valid(sb, blk_offset(last_valid), i);
+        if (ret < 0) {
+            printk(KERN_CRIT "%s: [put_data()] - errore durante la scrittura dei metadati sul blocco %d\n", MODNAME, last_valid);
+            ret = -EIO;
+            goto put_undo;
+        }
     }
 
     // se necessario aggiorno il primo blocco valido
-    if (sb_disk->first_valid == -1)
+    if (chan_first_valid(sb_disk, chan) == -1)
         new_first_valid = i;
     else
-        new_first_valid = sb_disk->first_valid;
+        new_first_valid = chan_first_valid(sb_disk, chan);
 
-    ret = set_sb_info(global_sb, new_first_valid, i);
+    ret = set_sb_info(sb, chan, new_first_valid, i);
     if (ret < 0) {
         printk(KERN_CRIT "%s: [put_data()] - errore durante la scrittura dei dati sul superblocco\n", MODNAME);
         ret = -EIO;
+        goto put_undo;
+    }
+
+    // blocco collegato: la voce riservata dell'indice viene riempita senza allocazioni
+    index_insert(sb, msg_seq, i);
+    FS_INFO(sb)->nr_valid++;
+    FS_INFO(sb)->chan[chan].nr_valid++;
+    FS_INFO(sb)->msg_time = msg_time;
+    smp_store_release(&(FS_INFO(sb)->msg_seq), msg_seq);
+    smp_store_release(&(FS_INFO(sb)->chan[chan].msg_seq), msg_seq);
+    render_bump(sb, chan, 0);
+    chan_size_add(sb, chan, size + 1);
+
+    op_seq = journal_end_op(sb);
+    if (seq != NULL)
+        *seq = op_seq;
+
+    // commit della transazione secondo la politica di write-back del montaggio
+    mode = async ? COMMIT_ASYNC : READ_ONCE(FS_INFO(sb)->opts.commit_mode);
+    ret = journal_commit_mode(sb, mode);
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: [put_data()] - errore durante il commit del journal\n", MODNAME);
+        ret = -EIO;
         goto put_exit;
     }
 
-    print_block_status(global_sb);
+    notify_event(sb, NOTIFY_PUT, i, op_seq);
+    AUDIT print_block_status(sb);
     ret = i;
-
+    goto put_exit;
+
+put_undo:
+    // inserimento fallito prima della fine dell'operazione: i record già registrati escono dalla transazione e il
+    // blocco non è stato collegato alla catena
+    journal_abort_op(sb);
+    WRITE_ONCE(FS_INFO(sb)->block_seq[i], old_seq);
+    WRITE_ONCE(FS_INFO(sb)->block_time[i], old_time);
+    WRITE_ONCE(FS_INFO(sb)->block_chan[i], old_chan);
+    index_remove(sb, msg_seq);
+put_clear:
+    memset(data, 0, copied);
 put_exit:
-    kfree(klvl_buf);
-    mutex_unlock(&(fs_info.write_lock));
-    atomic_fetch_add(-1, &(fs_info.usage));
-    printk("%s: [put_data()] - scrittura sul blocco %d completata\n", MODNAME, i);
+    mutex_unlock(&(FS_INFO(sb)->write_lock));
+    if (bh != NULL)
+        brelse(bh);
+    // group commit: attesa (fuori dal lock) del commit condiviso con le scritture concorrenti
+    if (ret >= 0 && op_seq != 0 && mode == COMMIT_GROUP && journal_wait_durable(sb, op_seq) < 0)
+        ret = -EIO;
+    // risveglio dei lettori del canale in follow mode
+    if (ret >= 0)
+        wake_up_interruptible(&(FS_INFO(sb)->chan[chan].read_wq));
+    LOG printk("%s: [put_data()] - scrittura sul blocco %d completata\n", MODNAME, i);
+    return ret;
+}
+
+// inserimento di un messaggio già in memoria kernel (anelli di sottomissione del device a caratteri)
+int put_data_kernel(struct super_block *sb, unsigned int chan, char *buf, size_t size, int async, uint64_t *seq) {
+
+    int ret;
+
+    // incremento del contatore atomico degli utilizzi del file system
+    atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+
+    if (!FS_INFO(sb)->mounted) {
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -ENODEV;
+    }
+    size = strnlen(buf, size);
+    if (chan >= NCHANNELS || size == 0 || size >= DATA_SIZE) {
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -EINVAL;
+    }
+
+    ret = put_data_buf(sb, chan, buf, size, 0, async, seq);
+
+    atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
     return ret;
-} 
+}
+
+// inserisce size byte del buffer utente source in un blocco libero in coda al canale chan: con async il commit
+// viene lasciato al flusher del journal indipendentemente dalla politica del montaggio e il numero di sequenza
+// restituito in seq permette di attenderne la persistenza
+int put_data_user(struct super_block *sb, unsigned int chan, char *source, size_t size, int async, uint64_t *seq) {
+
+    int ret;
+
+    LOG printk("%s: [put_data()] - invocata\n", MODNAME);
+
+    // incremento del contatore atomico degli utilizzi del file system
+    atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+
+    // sanity checks
+    if (!FS_INFO(sb)->mounted) { // controlla se il file system è montato
+        LOG printk(KERN_INFO "%s: [put_data()] - il file system non è montato\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -ENODEV;
+    }  
+    if (source == NULL || chan >= NCHANNELS) {
+        LOG printk(KERN_INFO "%s: [put_data()] - source null o canale non valido\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -EINVAL;
+    }
+    if (size == 0) {
+        LOG printk(KERN_INFO "%s: [put_data()] - non vi sono dati da scrivere\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -EINVAL;
+    }
+    if (size >= DATA_SIZE) {
+        LOG printk(KERN_INFO "%s: [put_data()] - dimensione dei dati da scrivere maggiore del limite massimo memorizzabile in un blocco\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -EINVAL;
+    }
 
+    ret = put_data_buf(sb, chan, source, size, 1, async, seq);
 
-// get_data syscall - get size bytes from the block at the specified offset
+    atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+    return ret;
+}
+
+// put_data syscall - insert size byte of the source in a free block (default mount)
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,17,0)
-__SYSCALL_DEFINEx(3, _get_data, int, offset, char*, destination, size_t, size) {
+__SYSCALL_DEFINEx(2, _put_data, char*, source, size_t, size) {
 #else
-asmlinkage int sys_get_data(int offset, char* destination, size_t size) {
+asmlinkage int sys_put_data(char* source, size_t size) {
 #endif
 
+    int ret;
+    struct super_block *sb;
+
+    sb = singlefilefs_get_default();
+    if (sb == NULL)
+        return -ENODEV;
+    ret = put_data_user(sb, 0, source, size, 0, NULL);
+    deactivate_super(sb);
+
+    return ret;
+}
+
+
+// copia nel buffer destination (utente oppure, se user è 0, kernel) al più size byte del messaggio valido
+// all'offset indicato, seguiti dal terminatore
+static int get_data_buf(struct super_block *sb, int offset, char *destination, size_t size, int user) {
+
     int ret;
     int return_val;
     int len;
     int srcu_idx;
+    size_t copied;
     char end_str = '\0';
     // struct onefilefs_sb_info *sb_disk;
     struct bdev_layout *bdev_blk;
 
-    printk("%s: [get_data()] - invocata\n", MODNAME);
+    LOG printk("%s: [get_data()] - invocata\n", MODNAME);
 
     // incremento del contatore atomico degli utilizzi del file system
-    atomic_fetch_add(1, &(fs_info.usage));
+    atomic_fetch_add(1, &(FS_INFO(sb)->usage));
 
     // sanity checks
-    if (!fs_info.mounted) { // controlla se il file system è montato
-        printk(KERN_INFO "%s: [get_data()] - il file system non è montato\n", MODNAME);
+    if (!FS_INFO(sb)->mounted) { // controlla se il file system è montato
+        LOG printk(KERN_INFO "%s: [get_data()] - il file system non è montato\n", MODNAME);
         return_val = -ENODEV;
         goto get_exit;
     } 
     if (destination == NULL) {
-        printk(KERN_INFO "%s: [get_data()] - destination null\n", MODNAME);
+        LOG printk(KERN_INFO "%s: [get_data()] - destination null\n", MODNAME);
         return_val = -EINVAL;
         goto get_exit;
     } 
     // if (size >= DATA_SIZE) size = DATA_SIZE; // se richiesta una dimensione superiore alla massima ritorna tutto il contenuto di default
     if (size < 0 || offset < 0 || offset >= NBLOCKS-2) {
-        printk(KERN_INFO "%s: [get_data()] - parametri non validi\n", MODNAME);
+        LOG printk(KERN_INFO "%s: [get_data()] - parametri non validi\n", MODNAME);
         return_val = -EINVAL;
         goto get_exit;
     }
     
     // acquisizione della sleepable RCU read lock
-    srcu_idx = srcu_read_lock(&(fs_info.srcu));
+    srcu_idx = srcu_read_lock(&(FS_INFO(sb)->srcu));
     
     // recupero del blocco da leggere
-    bdev_blk = get_block(global_sb, blk_offset(offset));
+    bdev_blk = get_block(sb, blk_offset(offset));
     if (bdev_blk == NULL) {
         printk(KERN_CRIT "%s: [get_data()] - errore durante il recupero del blocco %d\n", MODNAME, offset);
-        srcu_read_unlock(&(fs_info.srcu), srcu_idx);
+        srcu_read_unlock(&(FS_INFO(sb)->srcu), srcu_idx);
         return_val = -EIO;
         goto get_exit;
     }
 
-    // rilascio della sleepable RCU read lock
-    srcu_read_unlock(&(fs_info.srcu), srcu_idx);
-
-    // controllo validità del blocco target
-    if (!get_validity(bdev_blk->next_block)) {
-        printk(KERN_INFO "%s: [get_data()] - il blocco %d non è valido\n", MODNAME, offset);
+    // controllo validità del blocco target (i blocchi di continuazione si leggono solo tramite il primo blocco del messaggio)
+    if (!block_is_message(bdev_blk)) {
+        LOG printk(KERN_INFO "%s: [get_data()] - il blocco %d non è valido\n", MODNAME, offset);
+        srcu_read_unlock(&(FS_INFO(sb)->srcu), srcu_idx);
         return_val = -ENODATA;
         goto get_exit;
     }
 
-    // consegna dei dati all'utente
-    len = strlen(bdev_blk->data);
-    if (size > len) // richiesta una size maggiore del contenuto effettivo del blocco dati
-        size = len; 
-    
-    ret = copy_to_user(destination, bdev_blk->data, size);
-    return_val = size - ret;
-    ret = copy_to_user(destination+return_val, &end_str, 1);
+    // consegna dei dati all'utente (coerente con eventuali aggiornamenti in-place concorrenti); i blocchi di
+    // continuazione vengono liberati solo dopo il grace period, quindi la copia avviene dentro la sezione di lettura
+    if (user)
+        len = copy_message_to_user(sb, offset, bdev_blk, (char __user *) destination, 0, size, &copied);
+    else
+        len = copy_message_to_kernel(sb, offset, bdev_blk, destination, 0, size, &copied);
+
+    // rilascio della sleepable RCU read lock
+    srcu_read_unlock(&(FS_INFO(sb)->srcu), srcu_idx);
+
+    if (len < 0) {
+        return_val = len;
+        goto get_exit;
+    }
+    return_val = copied;
+    if (user)
+        ret = copy_to_user((char __user *) destination + return_val, &end_str, 1);
+    else
+        destination[return_val] = end_str;
 
 get_exit:
-    atomic_fetch_add(-1, &(fs_info.usage));
-    printk("%s: [get_data()] - lettura del blocco %d completata\n", MODNAME, offset);
+    atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+    LOG printk("%s: [get_data()] - lettura del blocco %d completata\n", MODNAME, offset);
     return return_val; // the amount of bytes actually loaded into the destination area
 }
 
+int get_data_user(struct super_block *sb, int offset, char __user *destination, size_t size) {
+
+    return get_data_buf(sb, offset, (char *) destination, size, 1);
+}
+
+// destination deve avere spazio per size+1 byte (terminatore)
+int get_data_kernel(struct super_block *sb, int offset, char *destination, size_t size) {
+
+    return get_data_buf(sb, offset, destination, size, 0);
+}
 
-// invalidate_data syscall - invalidate the block at specified offset
+// get_data syscall - get size bytes from the block at the specified offset (default mount)
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,17,0)
-__SYSCALL_DEFINEx(1, _invalidate_data, int, offset) {
+__SYSCALL_DEFINEx(3, _get_data, int, offset, char*, destination, size_t, size) {
 #else
-asmlinkage int sys_invalidate_data(int offset) {
+asmlinkage int sys_get_data(int offset, char* destination, size_t size) {
 #endif
 
     int ret;
+    struct super_block *sb;
+
+    sb = singlefilefs_get_default();
+    if (sb == NULL)
+        return -ENODEV;
+    ret = get_data_user(sb, offset, destination, size);
+    deactivate_super(sb);
+
+    return ret;
+}
+
+
+// invalida il messaggio valido all'offset indicato; il numero di sequenza dell'operazione viene restituito in seq
+int invalidate_data_user(struct super_block *sb, int offset, uint64_t *seq) {
+
+    int ret;
+    int len;
+    unsigned int chan;
+    unsigned int mode = COMMIT_SYNC;
     unsigned int new_first_valid;
     unsigned int new_last_valid;
+    unsigned int first_valid;
+    unsigned int last_valid;
+    uint64_t op_seq = 0;
     struct bdev_layout *bdev_blk;
     struct onefilefs_sb_info *sb_disk;
 
     new_first_valid = -1;
     new_last_valid = -1;
 
-    printk("%s: [invalidate_data()] - invocata\n", MODNAME);
+    LOG printk("%s: [invalidate_data()] - invocata\n", MODNAME);
 
     // incremento del contatore atomico degli utilizzi del file system
-    atomic_fetch_add(1, &(fs_info.usage));
+    atomic_fetch_add(1, &(FS_INFO(sb)->usage));
 
     // sanity checks
-    if (!fs_info.mounted) { // controlla se il file system è montato
-        printk(KERN_INFO "%s: [invalidate_data()] - il file system non è montato\n", MODNAME);
-        atomic_fetch_add(-1, &(fs_info.usage));
+    if (!FS_INFO(sb)->mounted) { // controlla se il file system è montato
+        LOG printk(KERN_INFO "%s: [invalidate_data()] - il file system non è montato\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
         return -ENODEV;
     } 
     if (offset < 0 || offset >= NBLOCKS-2) {
-        printk(KERN_INFO "%s: [invalidate_data()] - parametri non validi\n", MODNAME);
-        atomic_fetch_add(-1, &(fs_info.usage));
+        LOG printk(KERN_INFO "%s: [invalidate_data()] - parametri non validi\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
         return -EINVAL;
     }
 
-    // prendo il lock per sincronizzare gli scrittori (no concorrenza su tutte le operazioni di scrittura fino al rilascio del lock)
-    mutex_lock(&(fs_info.write_lock));
+    // lock del canale del blocco: serializza le invalidazioni sul canale, che rilasciano il write_lock durante il grace period
+    chan = lock_block_channel(sb, offset);
+
+    // prendo il lock per sincronizzare gli scrittori sulle strutture condivise
+    mutex_lock(&(FS_INFO(sb)->write_lock));
 
     // recupero dei dati memorizzati nel superblocco
-    sb_disk = get_sb_info(global_sb);
+    sb_disk = get_sb_info(sb);
     if (sb_disk == NULL) {
         printk(KERN_CRIT "%s: [invalidate_data()] - errore durante il recupero del superblocco\n", MODNAME);
         ret = -EIO;
@@ -267,76 +445,563 @@ asmlinkage int sys_invalidate_data(int offset) {
     }
 
     // recupero del blocco da invalidare
-    bdev_blk = get_block(global_sb, blk_offset(offset));
+    bdev_blk = get_block(sb, blk_offset(offset));
     if (bdev_blk == NULL) {
         printk(KERN_CRIT "%s: [invalidate_data()] - errore durante il recupero del blocco %d\n", MODNAME, offset);
         ret = -EIO;
         goto inv_exit;
     }
 
-    // controllo se il blocco è già stato invalidato
-    if (!(get_validity(bdev_blk->next_block))) {
-        printk(KERN_INFO "%s: [invalidate_data()] - il blocco %d è già stato invalidato\n", MODNAME, offset);
+    // controllo se il blocco è già stato invalidato (o è un blocco di continuazione, che segue il proprio messaggio,
+    // oppure è stato riallocato a un altro canale dopo l'invalidazione)
+    if (!block_is_message(bdev_blk) || FS_INFO(sb)->block_chan[offset] != chan) {
+        LOG printk(KERN_INFO "%s: [invalidate_data()] - il blocco %d è già stato invalidato\n", MODNAME, offset);
         ret = -ENODATA;
         goto inv_exit;
     }
 
-    // attesa della fine del grace period
-    synchronize_srcu(&(fs_info.srcu));
+    // lunghezza del messaggio, sottratta al contenuto del canale dopo lo scollegamento
+    len = message_len(sb, bdev_blk);
+    if (len < 0) {
+        printk(KERN_CRIT "%s: [invalidate_data()] - lunghezza non valida nel messaggio del blocco %d\n", MODNAME, offset);
+        ret = -EIO;
+        goto inv_exit;
+    }
+    first_valid = chan_first_valid(sb_disk, chan);
+    last_valid = chan_last_valid(sb_disk, chan);
 
     // il blocco da invalidare è l'unico blocco valido
-    if ((sb_disk->first_valid == offset) && (sb_disk->last_valid == offset)) {
-        ret = invalidate_one(global_sb, offset, new_first_valid, new_last_valid);
+    if ((first_valid == offset) && (last_valid == offset)) {
+        ret = invalidate_one(sb, chan, offset, new_first_valid, new_last_valid);
         if (ret < 0) {
             printk(KERN_CRIT "%s: [invalidate_data()] - errore durante l'invalidazione dell'unico blocco valido %d\n", MODNAME, offset);
             ret = -EIO;
-            goto inv_exit;
+            goto inv_abort;
         }
     }
     // il blocco da invalidare è il primo blocco valido, ma non l'ultimo
-    else if ((sb_disk->first_valid == offset) && (sb_disk->last_valid != offset)) {
+    else if ((first_valid == offset) && (last_valid != offset)) {
         // aggiorno i dati che andranno nel superblocco
         new_first_valid = get_block_num(bdev_blk->next_block);
-        new_last_valid = sb_disk->last_valid;
+        new_last_valid = last_valid;
 
-        ret = invalidate_first(global_sb, offset, new_first_valid, new_last_valid);
+        ret = invalidate_first(sb, chan, offset, new_first_valid, new_last_valid);
         if (ret < 0) {
             printk(KERN_CRIT "%s: [invalidate_data()] - errore durante l'invalidazione del blocco in testa %d\n", MODNAME, offset);
             ret = -EIO;
-            goto inv_exit;
+            goto inv_abort;
         }
     }
     // il blocco da invalidare è l'ultimo blocco valido, ma non il primo
-    else if ((sb_disk->first_valid != offset) && (sb_disk->last_valid == offset)) {
-        ret = invalidate_last(global_sb, offset, sb_disk->first_valid, sb_disk->last_valid, get_block_num(bdev_blk->next_block));
+    else if ((first_valid != offset) && (last_valid == offset)) {
+        ret = invalidate_last(sb, chan, offset, first_valid, last_valid, get_block_num(bdev_blk->next_block));
         if (ret < 0) {
             printk(KERN_CRIT "%s: [invalidate_data()] - errore durante l'invalidazione dell'ultimo blocco %d\n", MODNAME, offset);
             ret = -EIO;
-            goto inv_exit;
+            goto inv_abort;
         }
     }
     // il blocco da invalidare non è né il primo né l'ultimo
     else {
-        ret = invalidate_middle(global_sb, sb_disk->first_valid, offset);
+        ret = invalidate_middle(sb, first_valid, offset);
         if (ret < 0) {
             printk(KERN_CRIT "%s: [invalidate_data()] - errore durante l'invalidazione di un blocco nel mezzo\n", MODNAME);
             ret = -EIO;
-            goto inv_exit;
+            goto inv_abort;
         }
     }
 
-    printk(KERN_INFO "%s: [invalidate_data()] - new_first_valid: %d | new_last_valid: %d\n", MODNAME, sb_disk->first_valid, sb_disk->last_valid);
-    print_block_status(global_sb);
+    // il messaggio non è più raggiungibile neanche dai cursori
+    index_remove(sb, FS_INFO(sb)->block_seq[offset]);
+    FS_INFO(sb)->nr_valid--;
+    FS_INFO(sb)->chan[chan].nr_valid--;
+    render_bump(sb, chan, 1);
+    chan_size_add(sb, chan, -(int64_t) (len + 1));
+
+    // lo scollegamento è un'operazione completa: durante il grace period un commit concorrente può renderlo persistente
+    journal_end_op(sb);
+
+    // attesa della fine del grace period: nessun lettore può più trovarsi sul blocco scollegato; il write_lock viene
+    // rilasciato durante l'attesa (il blocco resta valido, quindi non può essere riallocato) e gli altri canali
+    // possono proseguire, mentre il lock del canale impedisce una seconda invalidazione del blocco
+    mutex_unlock(&(FS_INFO(sb)->write_lock));
+    synchronize_srcu(&(FS_INFO(sb)->srcu));
+    mutex_lock(&(FS_INFO(sb)->write_lock));
+
+    // invalidazione del blocco (aggiornamento dei suoi metadati), ora disponibile per nuove put_data(); se fallisce
+    // il blocco resta valido ma fuori dalla catena e viene liberato da check_chain() al prossimo montaggio
+    ret = invalidate_block(sb, blk_offset(offset));
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: [invalidate_data()] - errore durante l'invalidazione del blocco %d\n", MODNAME, offset);
+        ret = -EIO;
+        goto inv_abort;
+    }
+    op_seq = journal_end_op(sb);
+
+    // commit della transazione secondo la politica di write-back del montaggio
+    mode = READ_ONCE(FS_INFO(sb)->opts.commit_mode);
+    ret = journal_commit_mode(sb, mode);
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: [invalidate_data()] - errore durante il commit del journal\n", MODNAME);
+        ret = -EIO;
+        goto inv_exit;
+    }
+
+    notify_event(sb, NOTIFY_INVALIDATE, offset, op_seq);
+    if (seq != NULL)
+        *seq = op_seq;
+    LOG printk(KERN_INFO "%s: [invalidate_data()] - canale %u | new_first_valid: %d | new_last_valid: %d\n", MODNAME, chan, chan_first_valid(sb_disk, chan), chan_last_valid(sb_disk, chan));
+    AUDIT print_block_status(sb);
     ret = 0;
+    goto inv_exit;
 
+inv_abort:
+    // operazione fallita dopo la registrazione dei primi record: la transazione torna all'ultimo journal_end_op()
+    journal_abort_op(sb);
 inv_exit:
-    mutex_unlock(&(fs_info.write_lock));
-    atomic_fetch_add(-1, &(fs_info.usage));
-    printk("%s: [invalidate_data()] - invalidazione del blocco %d completata\n", MODNAME, offset);
+    mutex_unlock(&(FS_INFO(sb)->write_lock));
+    mutex_unlock(&(FS_INFO(sb)->chan[chan].lock));
+    if (ret == 0 && mode == COMMIT_GROUP && journal_wait_durable(sb, op_seq) < 0)
+        ret = -EIO;
+    atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+    LOG printk("%s: [invalidate_data()] - invalidazione del blocco %d completata\n", MODNAME, offset);
+    return ret;
+}
+
+// invalidate_data syscall - invalidate the block at specified offset (default mount)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,17,0)
+__SYSCALL_DEFINEx(1, _invalidate_data, int, offset) {
+#else
+asmlinkage int sys_invalidate_data(int offset) {
+#endif
+
+    int ret;
+    struct super_block *sb;
+
+    sb = singlefilefs_get_default();
+    if (sb == NULL)
+        return -ENODEV;
+    ret = invalidate_data_user(sb, offset, NULL);
+    deactivate_super(sb);
+
+    return ret;
+}
+
+
+// sostituisce atomicamente il contenuto del messaggio valido all'offset indicato con size byte del buffer utente
+// source, mantenendone la posizione nella catena e il numero di sequenza
+int update_data_user(struct super_block *sb, int offset, char __user *source, size_t size, uint64_t *seq) {
+
+    int ret;
+    unsigned int chan;
+    unsigned int mode = COMMIT_SYNC;
+    unsigned int cont;
+    int old_len;
+    uint64_t op_seq = 0;
+    char *klvl_buf;
+    struct bdev_layout *bdev_blk;
+
+    LOG printk("%s: [update_data()] - invocata\n", MODNAME);
+
+    // incremento del contatore atomico degli utilizzi del file system
+    atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+
+    // sanity checks
+    if (!FS_INFO(sb)->mounted) { // controlla se il file system è montato
+        LOG printk(KERN_INFO "%s: [update_data()] - il file system non è montato\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -ENODEV;
+    }
+    if (source == NULL || size == 0 || size >= DATA_SIZE || offset < 0 || offset >= NBLOCKS-2) {
+        LOG printk(KERN_INFO "%s: [update_data()] - parametri non validi\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -EINVAL;
+    }
+
+    // copia del nuovo messaggio fuori dal lock (come in put_data() il messaggio termina al primo '\0')
+    klvl_buf = kmalloc(size+1, GFP_KERNEL);
+    if (!klvl_buf) {
+        printk(KERN_CRIT "%s: [update_data()] - impossibile allocare memoria per la ricezione del buffer utente\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -ENOMEM;
+    }
+    if (copy_from_user(klvl_buf, source, size)) {
+        ret = -EFAULT;
+        goto update_exit_nolock;
+    }
+    klvl_buf[size] = '\0';
+    size = strlen(klvl_buf);
+    if (size == 0) {
+        LOG printk(KERN_INFO "%s: [update_data()] - non vi sono dati da scrivere\n", MODNAME);
+        ret = -EINVAL;
+        goto update_exit_nolock;
+    }
+
+    // lock del canale del blocco: le invalidazioni sul canale rilasciano il write_lock durante il grace period
+    // dopo aver staccato il blocco dalla catena, quindi senza questo lock il blocco potrebbe essere già scollegato
+    chan = lock_block_channel(sb, offset);
+
+    // prendo il lock per sincronizzare gli scrittori sulle strutture condivise
+    mutex_lock(&(FS_INFO(sb)->write_lock));
+
+    bdev_blk = get_block(sb, blk_offset(offset));
+    if (bdev_blk == NULL) {
+        printk(KERN_CRIT "%s: [update_data()] - errore durante il recupero del blocco %d\n", MODNAME, offset);
+        ret = -EIO;
+        goto update_exit;
+    }
+
+    // solo i messaggi validi possono essere aggiornati (sotto il lock del canale il blocco non può essere invalidato)
+    if (!block_is_message(bdev_blk) || FS_INFO(sb)->block_chan[offset] != chan) {
+        LOG printk(KERN_INFO "%s: [update_data()] - il blocco %d non è valido\n", MODNAME, offset);
+        ret = -ENODATA;
+        goto update_exit;
+    }
+
+    // una sola scrittura del blocco dati (contenuto e lunghezza), nessuna modifica alla catena
+    old_len = message_len(sb, bdev_blk);
+    if (old_len < 0) {
+        printk(KERN_CRIT "%s: [update_data()] - lunghezza non valida nel messaggio del blocco %d\n", MODNAME, offset);
+        ret = -EIO;
+        goto update_exit;
+    }
+    ret = update_block_data(sb, blk_offset(offset), klvl_buf, size, &cont);
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: [update_data()] - errore durante la scrittura dei dati sul blocco %d\n", MODNAME, offset);
+        ret = -EIO;
+        goto update_abort;
+    }
+    render_bump(sb, chan, 1);
+    chan_size_add(sb, chan, (int64_t) size - old_len);
+
+    // i blocchi di continuazione staccati dal messaggio vengono liberati dopo il grace period (atteso senza il
+    // write_lock: i blocchi restano validi, quindi non possono essere riallocati); l'aggiornamento è già
+    // un'operazione completa e, se il rilascio fallisce, i blocchi restano validi fino a check_chain()
+    if (get_validity(cont)) {
+        journal_end_op(sb);
+        mutex_unlock(&(FS_INFO(sb)->write_lock));
+        synchronize_srcu(&(FS_INFO(sb)->srcu));
+        mutex_lock(&(FS_INFO(sb)->write_lock));
+        if (release_continuation(sb, cont) < 0) {
+            printk(KERN_CRIT "%s: [update_data()] - errore durante il rilascio dei blocchi di continuazione del blocco %d\n", MODNAME, offset);
+            ret = -EIO;
+            goto update_abort;
+        }
+    }
+    op_seq = journal_end_op(sb);
+    if (seq != NULL)
+        *seq = op_seq;
+
+    // commit della transazione secondo la politica di write-back del montaggio
+    mode = READ_ONCE(FS_INFO(sb)->opts.commit_mode);
+    ret = journal_commit_mode(sb, mode);
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: [update_data()] - errore durante il commit del journal\n", MODNAME);
+        ret = -EIO;
+        goto update_exit;
+    }
+
+    notify_event(sb, NOTIFY_UPDATE, offset, op_seq);
+    AUDIT print_block_status(sb);
+    ret = size;
+    goto update_exit;
+
+update_abort:
+    // il blocco riprende il contenuto precedente e la transazione torna all'ultimo journal_end_op()
+    journal_abort_op(sb);
+update_exit:
+    mutex_unlock(&(FS_INFO(sb)->write_lock));
+    mutex_unlock(&(FS_INFO(sb)->chan[chan].lock));
+    if (ret >= 0 && mode == COMMIT_GROUP && journal_wait_durable(sb, op_seq) < 0)
+        ret = -EIO;
+update_exit_nolock:
+    kfree(klvl_buf);
+    atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+    LOG printk("%s: [update_data()] - aggiornamento del blocco %d completato\n", MODNAME, offset);
     return ret;
 }
 
 
+// accoda size byte del buffer utente source al messaggio valido all'offset indicato, senza invalidarlo né
+// modificare la catena: i byte che non entrano nel blocco vengono scritti in un blocco di continuazione
+int append_data_user(struct super_block *sb, int offset, char __user *source, size_t size, uint64_t *seq) {
+
+    int ret;
+    int cont;
+    unsigned int chan;
+    unsigned int mode = COMMIT_SYNC;
+    uint64_t op_seq = 0;
+    char *klvl_buf;
+    struct bdev_layout *bdev_blk;
+
+    LOG printk("%s: [append_data()] - invocata\n", MODNAME);
+
+    // incremento del contatore atomico degli utilizzi del file system
+    atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+
+    // sanity checks
+    if (!FS_INFO(sb)->mounted) { // controlla se il file system è montato
+        LOG printk(KERN_INFO "%s: [append_data()] - il file system non è montato\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -ENODEV;
+    }
+    if (source == NULL || size == 0 || size >= DATA_SIZE || offset < 0 || offset >= NBLOCKS-2) {
+        LOG printk(KERN_INFO "%s: [append_data()] - parametri non validi\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -EINVAL;
+    }
+
+    // copia dei byte da accodare fuori dal lock (come in put_data() i dati terminano al primo '\0')
+    klvl_buf = kmalloc(size+1, GFP_KERNEL);
+    if (!klvl_buf) {
+        printk(KERN_CRIT "%s: [append_data()] - impossibile allocare memoria per la ricezione del buffer utente\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -ENOMEM;
+    }
+    if (copy_from_user(klvl_buf, source, size)) {
+        ret = -EFAULT;
+        goto append_exit_nolock;
+    }
+    klvl_buf[size] = '\0';
+    size = strlen(klvl_buf);
+    if (size == 0) {
+        LOG printk(KERN_INFO "%s: [append_data()] - non vi sono dati da scrivere\n", MODNAME);
+        ret = -EINVAL;
+        goto append_exit_nolock;
+    }
+
+    // lock del canale del blocco: le invalidazioni sul canale rilasciano il write_lock durante il grace period
+    // dopo aver staccato il blocco dalla catena, quindi senza questo lock il blocco potrebbe essere già scollegato
+    chan = lock_block_channel(sb, offset);
+
+    // prendo il lock per sincronizzare gli scrittori sulle strutture condivise
+    mutex_lock(&(FS_INFO(sb)->write_lock));
+
+    bdev_blk = get_block(sb, blk_offset(offset));
+    if (bdev_blk == NULL) {
+        printk(KERN_CRIT "%s: [append_data()] - errore durante il recupero del blocco %d\n", MODNAME, offset);
+        ret = -EIO;
+        goto append_exit;
+    }
+
+    // solo i messaggi validi possono essere estesi (sotto il lock del canale il blocco non può essere invalidato)
+    if (!block_is_message(bdev_blk) || FS_INFO(sb)->block_chan[offset] != chan) {
+        LOG printk(KERN_INFO "%s: [append_data()] - il blocco %d non è valido\n", MODNAME, offset);
+        ret = -ENODATA;
+        goto append_exit;
+    }
+
+    // scrittura dei soli byte nuovi (ed eventualmente di un blocco di continuazione), nessuna modifica alla catena
+    cont = append_block_data(sb, blk_offset(offset), klvl_buf, size);
+    if (cont == -ENOMEM) {
+        LOG printk(KERN_INFO "%s: [append_data()] - nessun blocco disponibile per la continuazione del messaggio\n", MODNAME);
+        ret = -ENOMEM;
+        goto append_exit;
+    }
+    if (cont < -1) {
+        printk(KERN_CRIT "%s: [append_data()] - errore durante la scrittura dei dati sul blocco %d\n", MODNAME, offset);
+        ret = -EIO;
+        goto append_abort;
+    }
+    if (cont >= 0)
+        LOG printk(KERN_INFO "%s: [append_data()] - messaggio del blocco %d continuato nel blocco %d\n", MODNAME, offset, cont);
+    render_bump(sb, chan, 1);
+    chan_size_add(sb, chan, size);
+    op_seq = journal_end_op(sb);
+    if (seq != NULL)
+        *seq = op_seq;
+
+    // commit della transazione secondo la politica di write-back del montaggio
+    mode = READ_ONCE(FS_INFO(sb)->opts.commit_mode);
+    ret = journal_commit_mode(sb, mode);
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: [append_data()] - errore durante il commit del journal\n", MODNAME);
+        ret = -EIO;
+        goto append_exit;
+    }
+
+    notify_event(sb, NOTIFY_APPEND, offset, op_seq);
+    AUDIT print_block_status(sb);
+    ret = size;
+    goto append_exit;
+
+append_abort:
+    // l'ultimo blocco riprende il contenuto precedente, l'eventuale blocco di continuazione torna libero e la
+    // transazione torna all'ultimo journal_end_op()
+    journal_abort_op(sb);
+append_exit:
+    mutex_unlock(&(FS_INFO(sb)->write_lock));
+    mutex_unlock(&(FS_INFO(sb)->chan[chan].lock));
+    if (ret >= 0 && mode == COMMIT_GROUP && journal_wait_durable(sb, op_seq) < 0)
+        ret = -EIO;
+append_exit_nolock:
+    kfree(klvl_buf);
+    atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+    LOG printk("%s: [append_data()] - accodamento al blocco %d completato\n", MODNAME, offset);
+    return ret;
+}
+
+
+// invalida più messaggi (per lista di offset, intervallo di sequenze o tutti) con un'unica visita della catena,
+// un solo grace period e un solo commit; restituisce il numero di messaggi invalidati
+int invalidate_data_bulk(struct super_block *sb, unsigned int chan, int by, int __user *offsets, unsigned int nr, uint64_t from, uint64_t to, uint64_t *seq) {
+
+    int i;
+    int ret;
+    int len;
+    int n = 0;
+    int64_t removed = 0;
+    int offset;
+    unsigned int mode = COMMIT_SYNC;
+    unsigned long index;
+    unsigned long *skip;
+    uint64_t op_seq = 0;
+    void *entry;
+    struct bdev_layout *bdev_blk;
+
+    LOG printk("%s: [invalidate_data_bulk()] - invocata\n", MODNAME);
+
+    if (by != INVALIDATE_LIST && by != INVALIDATE_SEQ_RANGE && by != INVALIDATE_ALL)
+        return -EINVAL;
+    if ((by == INVALIDATE_LIST && (offsets == NULL || nr > NBLOCKS-2)) || chan >= NCHANNELS)
+        return -EINVAL;
+
+    // incremento del contatore atomico degli utilizzi del file system
+    atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+
+    if (!FS_INFO(sb)->mounted) { // controlla se il file system è montato
+        LOG printk(KERN_INFO "%s: [invalidate_data_bulk()] - il file system non è montato\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -ENODEV;
+    }
+
+    // blocchi da invalidare
+    skip = bitmap_zalloc(NBLOCKS-2, GFP_KERNEL);
+    if (!skip) {
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+        return -ENOMEM;
+    }
+
+    // lock del canale (serializza le invalidazioni sul canale) e lock degli scrittori sulle strutture condivise
+    mutex_lock(&(FS_INFO(sb)->chan[chan].lock));
+    mutex_lock(&(FS_INFO(sb)->write_lock));
+
+    switch (by) {
+        case INVALIDATE_LIST:
+            for (i = 0; i < nr; i++) {
+                if (get_user(offset, offsets + i)) {
+                    ret = -EFAULT;
+                    goto bulk_exit;
+                }
+                if (offset < 0 || offset >= NBLOCKS-2) {
+                    ret = -EINVAL;
+                    goto bulk_exit;
+                }
+                set_bit(offset, skip);
+            }
+            break;
+        case INVALIDATE_SEQ_RANGE:
+            xa_for_each(&(FS_INFO(sb)->seq_index), index, entry) {
+                if (index > to)
+                    break;
+                if (index >= from)
+                    set_bit(xa_to_value(entry), skip);
+            }
+            break;
+        case INVALIDATE_ALL:
+            bitmap_fill(skip, NBLOCKS-2);
+            break;
+    }
+
+    // unica visita della catena: i blocchi da invalidare vengono scavalcati (quelli già invalidi non sono nella catena)
+    n = relink_chain(sb, chan, skip);
+    if (n < 0) {
+        printk(KERN_CRIT "%s: [invalidate_data_bulk()] - errore durante l'aggiornamento della catena\n", MODNAME);
+        ret = -EIO;
+        goto bulk_abort;
+    }
+    if (n == 0) {
+        ret = 0;
+        goto bulk_exit;
+    }
+
+    // i blocchi scollegati sono quelli ancora validi del canale tra quelli indicati (esclusi i blocchi di continuazione,
+    // liberati insieme al proprio messaggio)
+    for (i = 0; i < NBLOCKS-2; i++) {
+        if (!test_bit(i, skip))
+            continue;
+        bdev_blk = get_block(sb, blk_offset(i));
+        if (bdev_blk == NULL) {
+            ret = -EIO;
+            goto bulk_abort;
+        }
+        if (!block_is_message(bdev_blk) || FS_INFO(sb)->block_chan[i] != chan) {
+            clear_bit(i, skip);
+            continue;
+        }
+        len = message_len(sb, bdev_blk);
+        if (len < 0) {
+            ret = -EIO;
+            goto bulk_abort;
+        }
+        removed += len + 1;
+    }
+
+    // i messaggi scollegati escono dall'indice dopo il controllo di tutti i blocchi (un errore nella visita annulla il ricollegamento)
+    for_each_set_bit(i, skip, NBLOCKS-2)
+        index_remove(sb, FS_INFO(sb)->block_seq[i]);
+    FS_INFO(sb)->nr_valid -= n;
+    FS_INFO(sb)->chan[chan].nr_valid -= n;
+    render_bump(sb, chan, 1);
+    chan_size_add(sb, chan, -removed);
+
+    // un solo grace period per tutti i blocchi scollegati, atteso senza il write_lock (come in invalidate_data()):
+    // lo scollegamento è un'operazione completa e i blocchi la cui invalidazione fallisce restano validi fino a check_chain()
+    journal_end_op(sb);
+    mutex_unlock(&(FS_INFO(sb)->write_lock));
+    synchronize_srcu(&(FS_INFO(sb)->srcu));
+    mutex_lock(&(FS_INFO(sb)->write_lock));
+
+    for_each_set_bit(i, skip, NBLOCKS-2) {
+        if (invalidate_block(sb, blk_offset(i)) < 0) {
+            printk(KERN_CRIT "%s: [invalidate_data_bulk()] - errore durante l'invalidazione del blocco %d\n", MODNAME, i);
+            ret = -EIO;
+            goto bulk_abort;
+        }
+    }
+    op_seq = journal_end_op(sb);
+    if (seq != NULL)
+        *seq = op_seq;
+
+    // un solo commit secondo la politica di write-back del montaggio
+    mode = READ_ONCE(FS_INFO(sb)->opts.commit_mode);
+    ret = journal_commit_mode(sb, mode);
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: [invalidate_data_bulk()] - errore durante il commit del journal\n", MODNAME);
+        ret = -EIO;
+        goto bulk_exit;
+    }
+
+    for_each_set_bit(i, skip, NBLOCKS-2)
+        notify_event(sb, NOTIFY_INVALIDATE, i, op_seq);
+    AUDIT print_block_status(sb);
+    ret = n;
+    goto bulk_exit;
+
+bulk_abort:
+    // operazione fallita dopo la registrazione dei primi record: la transazione torna all'ultimo journal_end_op()
+    journal_abort_op(sb);
+bulk_exit:
+    mutex_unlock(&(FS_INFO(sb)->write_lock));
+    mutex_unlock(&(FS_INFO(sb)->chan[chan].lock));
+    if (ret > 0 && mode == COMMIT_GROUP && journal_wait_durable(sb, op_seq) < 0)
+        ret = -EIO;
+    bitmap_free(skip);
+    atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+    LOG printk("%s: [invalidate_data_bulk()] - invalidati %d messaggi (ret=%d)\n", MODNAME, n, ret);
+    return ret;
+}
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,17,0)       
 unsigned long sys_put_data = (unsigned long) __x64_sys_put_data;
 unsigned long sys_get_data = (unsigned long) __x64_sys_get_data;
@@ -2,11 +2,15 @@
 #define _COMMON_HEADER_H
 
 #define DEFAULT_BLOCK_SIZE 4096
-#define METADATA_SIZE 4
+#define METADATA_SIZE 32           // next_block, len, seq, timestamp, cont_block e flags (struct bdev_layout)
 #define DATA_SIZE (DEFAULT_BLOCK_SIZE - METADATA_SIZE)
 
-#define NBLOCKS 6                   // change here the number of the blocks (superblock and inode are included)
+#ifndef NBLOCKS
+#define NBLOCKS 6                   // change here the number of the blocks (superblock and inode are included), or pass NBLOCKS=<n> to make
+#endif
 #define IMAGE_PATH "../image"       // change this line with your image file path
+#define JOURNAL_BLOCKS 4            // blocks reserved to the journal, placed right after the NBLOCKS blocks
+#define NCHANNELS 4                 // independent logs sharing the data blocks (channel 0 is the-file)
 
 #define VALID_MASK 0x80000000       // 0x80000000 -> 1000 0000 ... 0000
 #define INVALID_MASK (~VALID_MASK)  // 0x7FFFFFFF -> 0111 1111 ... 1111
@@ -0,0 +1,245 @@
+#ifndef _IOCTL_HEADER_H
+#define _IOCTL_HEADER_H
+
+#include <linux/ioctl.h>
+
+// comandi ioctl accettati da the-file (condivisi tra il modulo del kernel e i programmi utente)
+#define BLOCKLEVEL_IOC_MAGIC 0xB5
+
+// put_data che ritorna non appena il messaggio è collegato alla catena in memoria
+struct put_data_args {
+    char *source;               // in: messaggio da inserire
+    size_t size;                // in: numero di byte di source
+    int block;                  // out: indice del blocco scritto
+    unsigned long long seq;     // out: numero di sequenza dell'operazione (da usare con IOCTL_BARRIER)
+};
+
+#define IOCTL_PUT_DATA_ASYNC _IOWR(BLOCKLEVEL_IOC_MAGIC, 1, struct put_data_args)
+#define IOCTL_BARRIER _IOW(BLOCKLEVEL_IOC_MAGIC, 2, unsigned long long)   // 0 attende tutte le operazioni avviate fino a quel momento
+#define IOCTL_FOLLOW _IOW(BLOCKLEVEL_IOC_MAGIC, 3, int)     // 1: a fine file read() si blocca in attesa di nuovi messaggi, 0: read() restituisce EOF
+
+// eventi consegnati dall'fd di notifica restituito da IOCTL_NOTIFY_FD
+#define NOTIFY_PUT 1            // è stato scritto un messaggio nel blocco block
+#define NOTIFY_INVALIDATE 2     // il blocco block è stato invalidato
+#define NOTIFY_OVERFLOW 3       // la coda era piena e gli eventi successivi sono stati scartati: riscandire i blocchi
+#define NOTIFY_UPDATE 4         // il messaggio del blocco block è stato sostituito con IOCTL_UPDATE_DATA
+#define NOTIFY_APPEND 5         // sono stati accodati byte al messaggio del blocco block con IOCTL_APPEND_DATA
+
+struct blocklevel_event {
+    unsigned int op;
+    unsigned int block;
+    unsigned long long seq;     // numero di sequenza dell'operazione (da usare con IOCTL_BARRIER)
+};
+
+#define IOCTL_NOTIFY_FD _IO(BLOCKLEVEL_IOC_MAGIC, 4)    // restituisce un fd in sola lettura che consegna record struct blocklevel_event
+
+// cursore sui messaggi di the-file nell'ordine della catena (un cursore per file aperto)
+#define CURSOR_HEAD 0           // prima del primo messaggio valido
+#define CURSOR_TAIL 1           // dopo l'ultimo messaggio valido: verranno restituiti solo i nuovi messaggi
+#define CURSOR_SEQ 2            // dopo il messaggio con numero di sequenza seq
+
+struct cursor_args {
+    int whence;
+    unsigned long long seq;
+};
+
+struct cursor_fetch_args {
+    char *buf;                  // in: destinazione dei record struct cursor_msg
+    size_t size;                // in: dimensione di buf
+    unsigned int max;           // in: numero massimo di messaggi da restituire
+    unsigned int count;         // out: numero di messaggi restituiti
+    unsigned long long seq;     // out: posizione del cursore (numero di sequenza dell'ultimo messaggio restituito)
+};
+
+// record restituito da IOCTL_CURSOR_FETCH: intestazione seguita da len byte di dati, allineato a 8 byte
+struct cursor_msg {
+    unsigned long long seq;     // numero di sequenza del messaggio
+    long long timestamp;        // istante di inserimento (ns dall'epoch)
+    unsigned int block;
+    unsigned int len;
+};
+
+#define CURSOR_MSG_SIZE(len) ((sizeof(struct cursor_msg) + (len) + 7) & ~7UL)
+
+#define IOCTL_CURSOR_OPEN _IOW(BLOCKLEVEL_IOC_MAGIC, 5, struct cursor_args)
+#define IOCTL_CURSOR_FETCH _IOWR(BLOCKLEVEL_IOC_MAGIC, 6, struct cursor_fetch_args)
+
+// messaggi con numero di sequenza (QUERY_SEQ) o istante di inserimento (QUERY_TIME) maggiore di value
+#define QUERY_SEQ 0
+#define QUERY_TIME 1
+
+struct query_args {
+    int by;                     // in: QUERY_SEQ oppure QUERY_TIME
+    long long value;            // in: numero di sequenza o istante (ns dall'epoch)
+    char *buf;                  // in: destinazione dei record struct cursor_msg
+    size_t size;                // in: dimensione di buf
+    unsigned int max;           // in: numero massimo di messaggi da restituire
+    unsigned int count;         // out: numero di messaggi restituiti
+    unsigned long long seq;     // out: sequenza dell'ultimo messaggio restituito (value di QUERY_SEQ per proseguire)
+};
+
+#define IOCTL_QUERY_SINCE _IOWR(BLOCKLEVEL_IOC_MAGIC, 7, struct query_args)
+
+// invalidazione di più messaggi con un unico ricollegamento della catena, un solo grace period e un solo commit
+#define INVALIDATE_LIST 0       // gli offset (indici dei blocchi) elencati in offsets
+#define INVALIDATE_SEQ_RANGE 1  // i messaggi con numero di sequenza in [from, to]
+#define INVALIDATE_ALL 2        // tutti i messaggi validi
+
+struct invalidate_args {
+    int by;
+    int *offsets;               // in: INVALIDATE_LIST, offset da invalidare (quelli già invalidi vengono saltati)
+    unsigned int nr;            // in: INVALIDATE_LIST, numero di offset
+    unsigned long long from;    // in: INVALIDATE_SEQ_RANGE
+    unsigned long long to;      // in: INVALIDATE_SEQ_RANGE
+    unsigned int count;         // out: numero di messaggi invalidati
+    unsigned long long seq;     // out: numero di sequenza dell'operazione (da usare con IOCTL_BARRIER)
+};
+
+#define IOCTL_INVALIDATE_BULK _IOWR(BLOCKLEVEL_IOC_MAGIC, 8, struct invalidate_args)
+
+// sostituzione atomica del messaggio di un blocco valido (stessa posizione nella catena e stesso numero di
+// sequenza): i lettori vedono il messaggio vecchio oppure quello nuovo, mai un misto dei due
+struct update_data_args {
+    int block;                  // in: offset del messaggio da sostituire
+    char *source;               // in: nuovo messaggio
+    size_t size;                // in: numero di byte di source
+    unsigned long long seq;     // out: numero di sequenza dell'operazione (da usare con IOCTL_BARRIER)
+};
+
+#define IOCTL_UPDATE_DATA _IOWR(BLOCKLEVEL_IOC_MAGIC, 9, struct update_data_args)
+
+// accodamento al messaggio di un blocco valido (stessa posizione nella catena e stesso numero di sequenza): i byte
+// che non entrano nel blocco vanno in un blocco di continuazione agganciato al messaggio, i lettori vedono il
+// messaggio prima o dopo l'accodamento
+#define IOCTL_APPEND_DATA _IOWR(BLOCKLEVEL_IOC_MAGIC, 10, struct update_data_args)
+
+// put sincrona sul canale del file aperto (the-file è il canale 0, channel-N il canale N)
+#define IOCTL_PUT_DATA _IOWR(BLOCKLEVEL_IOC_MAGIC, 11, struct put_data_args)
+
+// get_data() e invalidate_data() sul montaggio del file aperto (le system call agiscono sul primo device montato)
+struct get_data_args {
+    int block;                  // in: offset del messaggio da leggere
+    char *destination;          // in: buffer che riceve il messaggio
+    size_t size;                // in: dimensione di destination
+};
+
+#define IOCTL_GET_DATA _IOW(BLOCKLEVEL_IOC_MAGIC, 12, struct get_data_args)      // restituisce il numero di byte copiati
+
+struct invalidate_data_args {
+    int block;                  // in: offset del messaggio da invalidare
+    unsigned long long seq;     // out: numero di sequenza dell'operazione (da usare con IOCTL_BARRIER)
+};
+
+#define IOCTL_INVALIDATE_DATA _IOWR(BLOCKLEVEL_IOC_MAGIC, 13, struct invalidate_data_args)
+
+// versione dell'ABI delle ioctl descritta da questo header: comandi e strutture esistenti non cambiano mai, i nuovi
+// comandi vengono solo aggiunti (con una versione maggiore); gli stessi comandi sono accettati dai file del file
+// system montato e dal device a caratteri blockleveldev (che agisce sul primo device montato, come le system call)
+#define BLOCKLEVEL_ABI_VERSION 3
+
+#define IOCTL_ABI_VERSION _IO(BLOCKLEVEL_IOC_MAGIC, 14)    // restituisce BLOCKLEVEL_ABI_VERSION
+
+// forme a batch di put_data() e get_data() (la invalidate_data() a batch è IOCTL_INVALIDATE_BULK)
+#define BATCH_MAX 1024          // numero massimo di voci di un singolo batch
+
+struct batch_args {
+    void *entries;              // in: array di struct put_batch_entry o struct get_batch_entry
+    unsigned int nr;            // in: numero di voci
+    unsigned int done;          // out: numero di voci elaborate
+    unsigned long long seq;     // out: numero di sequenza dell'ultima operazione (da usare con IOCTL_BARRIER)
+};
+
+struct put_batch_entry {
+    char *source;               // in: messaggio da inserire
+    size_t size;                // in: numero di byte di source
+    int block;                  // out: indice del blocco scritto, oppure -errno per la voce che ha interrotto il batch
+};
+
+struct get_batch_entry {
+    int block;                  // in: offset del messaggio da leggere
+    char *destination;          // in: buffer che riceve il messaggio
+    size_t size;                // in: dimensione di destination
+    int ret;                    // out: numero di byte copiati oppure -errno
+};
+
+// put in ordine sul canale del file aperto, interrotte alla prima voce fallita; con un montaggio sync o
+// group_commit l'intero batch viene reso persistente da un unico commit prima di ritornare
+#define IOCTL_PUT_BATCH _IOWR(BLOCKLEVEL_IOC_MAGIC, 15, struct batch_args)
+// get di tutte le voci (un blocco non valido fa fallire solo la propria voce)
+#define IOCTL_GET_BATCH _IOWR(BLOCKLEVEL_IOC_MAGIC, 16, struct batch_args)
+
+// anelli di sottomissione e completamento condivisi con il kernel (sul modello di io_uring): dopo IOCTL_RING_SETUP
+// l'fd viene mappato con mmap (MAP_SHARED, offset 0, dimensione ring_setup_args.size); il produttore riempie le voci
+// struct ring_sqe a partire da sq_tail, le pubblica facendo avanzare sq_tail e suona il doorbell (IOCTL_RING_ENTER),
+// poi consuma le voci struct ring_cqe da cq_head a cq_tail. Gli indici crescono liberamente: la voce di indice i è
+// i & (entries - 1)
+#define RING_MAX_ENTRIES 4096
+#define RING_SLOT_SIZE 4096     // byte di dati del messaggio di ciascuna voce di sottomissione e completamento
+
+#define RING_OP_PUT 1           // put_data() dei len byte nello slot della voce di sottomissione
+#define RING_OP_GET 2           // get_data() di block nello slot della voce di completamento (terminato da NUL)
+#define RING_OP_INVALIDATE 3    // invalidate_data() di block
+
+struct ring_header {
+    unsigned int sq_head;       // scritto dal kernel: prossima voce di sottomissione da consumare
+    unsigned int sq_tail;       // scritto dal produttore: prossima voce di sottomissione da riempire
+    unsigned int cq_head;       // scritto dal consumatore: prossima voce di completamento da consumare
+    unsigned int cq_tail;       // scritto dal kernel: prossima voce di completamento da riempire
+    unsigned int entries;       // numero di voci di ciascun anello (potenza di 2)
+};
+
+struct ring_sqe {
+    unsigned int op;            // RING_OP_*
+    int block;                  // RING_OP_GET, RING_OP_INVALIDATE: offset del messaggio
+    unsigned int len;           // RING_OP_PUT: numero di byte del messaggio nello slot
+    unsigned int pad;
+    unsigned long long user_data;   // copiato nella voce di completamento
+};
+
+struct ring_cqe {
+    unsigned long long user_data;
+    unsigned long long seq;     // numero di sequenza della put o della invalidate (da usare con IOCTL_BARRIER)
+    int res;                    // blocco scritto (put), byte copiati nello slot (get), 0 (invalidate) oppure -errno
+    unsigned int pad;
+};
+
+struct ring_setup_args {
+    unsigned int entries;       // in: numero di voci di ciascun anello (potenza di 2, al più RING_MAX_ENTRIES)
+    unsigned int sqes_off;      // out: offset dell'array di struct ring_sqe nella mappatura
+    unsigned int cqes_off;      // out: offset dell'array di struct ring_cqe
+    unsigned int sq_data_off;   // out: offset degli slot delle voci di sottomissione (RING_SLOT_SIZE byte ciascuno)
+    unsigned int cq_data_off;   // out: offset degli slot delle voci di completamento
+    unsigned long long size;    // out: dimensione della mappatura
+};
+
+#define IOCTL_RING_SETUP _IOWR(BLOCKLEVEL_IOC_MAGIC, 17, struct ring_setup_args)
+// consuma tutte le voci di sottomissione pubblicate che trovano posto nell'anello di completamento e restituisce il
+// numero di voci consumate; le put vengono sottoposte a commit come in IOCTL_PUT_BATCH, quindi su un montaggio sync
+// i completamenti sono persistenti
+#define IOCTL_RING_ENTER _IO(BLOCKLEVEL_IOC_MAGIC, 18)
+
+// snapshot in sola lettura di the-file o di channel-N tramite mmap (MAP_SHARED o MAP_PRIVATE, PROT_READ, offset 0):
+// una tabella che descrive i messaggi del canale al momento della mmap, seguita da copie private dei blocchi dati
+// prese insieme alla tabella (la pagina del blocco i si trova a data_off + i * 4096, vengono mappati solo i blocchi
+// della tabella). Le modifiche successive non sono visibili nella mappatura: il numero di sequenza nell'intestazione
+// di ciascun blocco (all'offset SNAPSHOT_BLOCK_SEQ_OFF della pagina) coincide con quello della tabella, e una nuova
+// mmap prende un nuovo snapshot della tabella e dei blocchi
+#define SNAPSHOT_BLOCK_SEQ_OFF 8
+#define SNAPSHOT_CONT 0x1       // la voce prosegue il messaggio della voce precedente (blocco di continuazione)
+
+struct snapshot_header {
+    unsigned int nr;            // numero di struct snapshot_entry che seguono l'intestazione
+    unsigned int data_off;      // offset della pagina del blocco dati 0
+    unsigned long long seq;     // sequenza dell'ultimo messaggio del canale al momento dello snapshot
+    unsigned long long size;    // dimensione della mappatura (tabella e pagine dei dati)
+};
+
+struct snapshot_entry {
+    unsigned long long seq;     // numero di sequenza del messaggio
+    unsigned int offset;        // offset dei byte del messaggio nella mappatura
+    unsigned int len;           // numero di byte del messaggio a partire da offset
+    unsigned int block;         // blocco dati che contiene i byte
+    unsigned int flags;         // SNAPSHOT_CONT
+};
+
+#endif
@@ -0,0 +1,819 @@
+#include <linux/bitmap.h>
+#include <linux/blkdev.h>
+#include <linux/buffer_head.h>
+#include <linux/crc32.h>
+#include <linux/fs.h>
+#include <linux/jiffies.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+#include "utils_header.h"
+
+/*
+    Il journal è una regione circolare di JOURNAL_BLOCKS blocchi posta dopo i blocchi dati.
+    Ogni operazione di scrittura registra le modifiche ai metadati (campi next_block dei blocchi
+    e first_valid/last_valid del superblocco) nella transazione in costruzione e le applica ai
+    buffer in-place senza forzarne la scrittura. Il commit rende persistenti i blocchi dati
+    coinvolti e scrive un unico blocco di journal; i buffer in-place vengono riportati sul device
+    dal checkpoint del thread di writeback (writeback.c), che poi fa avanzare journal_seq nel superblocco.
+    I metadati della transazione in costruzione non devono raggiungere il device prima del suo commit:
+    i buffer in-place non vengono mai marcati dirty nella page cache e, finché la transazione è aperta,
+    dei blocchi che modifica viene scritta solo una copia con i valori dell'ultimo commit.
+    Ogni operazione riceve un numero di sequenza: le operazioni asincrone vengono raggruppate
+    e rese persistenti dal flusher in background, mentre journal_wait_durable() attende che
+    tutte le operazioni fino a una data sequenza abbiano raggiunto il device.
+    Un'operazione che fallisce dopo aver registrato i primi record viene annullata da journal_abort_op():
+    i suoi record escono dalla transazione in costruzione e i buffer in-place tornano ai valori precedenti,
+    quindi il commit successivo non rende persistente un'operazione a metà.
+*/
+
+static int journal_flush_inplace(struct super_block *, struct journal_info *);
+
+// aggiorna l'ultima operazione persistente e risveglia i thread in attesa
+static void journal_set_durable(struct journal_info *j, uint64_t op_seq) {
+
+    if (op_seq > j->durable_op_seq)
+        WRITE_ONCE(j->durable_op_seq, op_seq);
+    wake_up_all(&(j->durable_wq));
+}
+
+// calcolo del checksum di un blocco di journal
+static unsigned int journal_checksum(struct journal_block *jblk) {
+
+    unsigned int saved;
+    unsigned int crc;
+
+    saved = jblk->header.checksum;
+    jblk->header.checksum = 0;
+    crc = crc32_le(~0, (unsigned char *) jblk, sizeof(struct journal_header) + jblk->header.nr_records * sizeof(struct journal_record));
+    jblk->header.checksum = saved;
+
+    return crc;
+}
+
+// controlla se il blocco di journal è integro e appartiene alla sequenza attesa
+static int journal_block_valid(struct journal_block *jblk, uint64_t seq) {
+
+    if (jblk->header.magic != JOURNAL_MAGIC || jblk->header.seq != seq)
+        return 0;
+    if (jblk->header.nr_records > JOURNAL_RECORDS)
+        return 0;
+
+    return journal_checksum(jblk) == jblk->header.checksum;
+}
+
+// imposta testa e coda del canale chan in un'immagine del superblocco
+static void journal_set_head(struct onefilefs_sb_info *sb_disk, unsigned int chan, unsigned int first_valid, unsigned int last_valid) {
+
+    if (chan == 0) {
+        sb_disk->first_valid = first_valid;
+        sb_disk->last_valid = last_valid;
+    }
+    else {
+        sb_disk->channels[chan-1].first_valid = first_valid;
+        sb_disk->channels[chan-1].last_valid = last_valid;
+    }
+}
+
+// apre l'operazione corrente alla prima modifica dopo l'ultimo journal_end_op(): journal_abort_op() riporta la
+// transazione in costruzione e i buffer in-place a questo punto
+static void journal_begin_op(struct super_block *sb, struct journal_info *j) {
+
+    if (j->op_open)
+        return;
+
+    j->op_open = 1;
+    j->op_start_seq = j->next_seq;
+    j->op_start_nr = j->running->header.nr_records;
+    j->op_nr_used = FS_INFO(sb)->nr_used;
+}
+
+// chiude l'operazione corrente: le sue modifiche non possono più essere annullate
+static void journal_close_op(struct journal_info *j) {
+
+    int i;
+
+    for (i = 0; i < j->nr_saved; i++) {
+        put_bh(j->saved[i].bh);
+        j->saved[i].bh = NULL;
+    }
+    j->nr_saved = 0;
+    j->nr_undo = 0;
+    j->undo_lost = 0;
+    j->op_open = 0;
+    bitmap_zero(j->op_map, NBLOCKS);
+}
+
+// conserva il valore precedente del campo modificato da un record dell'operazione corrente
+static void journal_save_undo(struct journal_info *j, unsigned int type, unsigned int block, unsigned int value, unsigned int chan) {
+
+    if (j->nr_undo >= JOURNAL_MAX_UNDO) {
+        j->undo_lost = 1;
+        return;
+    }
+
+    j->undo[j->nr_undo].type = type;
+    j->undo[j->nr_undo].block = block;
+    j->undo[j->nr_undo].value = value;
+    j->undo[j->nr_undo].chan = chan;
+    j->nr_undo++;
+}
+
+// questa funzione applica un record al buffer in-place del blocco interessato (senza forzarne la scrittura);
+// per i record della transazione in costruzione (running) vengono conservati il valore dell'ultimo commit e quello
+// precedente all'operazione corrente
+static int journal_apply_record(struct super_block *sb, struct journal_record *rec, int running) {
+
+    int i;
+    struct buffer_head *bh;
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+    struct bdev_layout *bdev_blk;
+    struct onefilefs_sb_info *sb_disk;
+
+    switch (rec->type) {
+        case JREC_BLOCK:
+            if (rec->block < blk_offset(0) || rec->block >= NBLOCKS)
+                return -EINVAL;
+            bh = bread_block(sb, rec->block);
+            if (!bh)
+                return -EIO;
+            bdev_blk = (struct bdev_layout *) bh->b_data;
+            if (running) {
+                journal_begin_op(sb, j);
+                journal_save_undo(j, JREC_BLOCK, rec->block, bdev_blk->next_block, 0);
+                if (!test_and_set_bit(rec->block, j->running_map)) {
+                    j->committed_next[rec->block] = bdev_blk->next_block;
+                    __set_bit(rec->block, j->op_map);
+                }
+            }
+            bdev_blk->next_block = rec->value;
+            break;
+        case JREC_SB:
+            if (rec->chan >= NCHANNELS)
+                return -EINVAL;
+            bh = sb_bread(sb, SB_BLOCK_NUMBER);
+            if (!bh)
+                return -EIO;
+            sb_disk = (struct onefilefs_sb_info *) bh->b_data;
+            if (running) {
+                journal_begin_op(sb, j);
+                journal_save_undo(j, JREC_SB, chan_first_valid(sb_disk, rec->chan), chan_last_valid(sb_disk, rec->chan), rec->chan);
+                if (!test_and_set_bit(SB_BLOCK_NUMBER, j->running_map)) {
+                    for (i = 0; i < NCHANNELS; i++) {
+                        j->committed_head[i][0] = chan_first_valid(sb_disk, i);
+                        j->committed_head[i][1] = chan_last_valid(sb_disk, i);
+                    }
+                    __set_bit(SB_BLOCK_NUMBER, j->op_map);
+                }
+            }
+            journal_set_head(sb_disk, rec->chan, rec->block, rec->value);
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    mark_block_dirty(sb, bh);
+    brelse(bh);
+
+    return 0;
+}
+
+// scrive sul device una copia del buffer in-place bh in cui i metadati modificati dalla transazione in costruzione
+// hanno il valore dell'ultimo commit (write_lock acquisito): restituisce 0 se il blocco non contiene modifiche
+// ancora da committare (il chiamante può scrivere direttamente il buffer), 1 se la copia è stata scritta con
+// REQ_FUA (il blocco resta da scrivere dopo il commit) oppure un errore
+int journal_write_frozen(struct super_block *sb, struct buffer_head *bh) {
+
+    int i;
+    int ret;
+    sector_t block = bh->b_blocknr;
+    struct page *page;
+    struct buffer_head *fbh;
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+
+    if (block >= NBLOCKS || !test_bit(block, j->running_map))
+        return 0;
+
+    // un blocco libero all'ultimo commit può raggiungere il device in anticipo: se il commit non avviene resta
+    // un blocco valido non raggiungibile dalla catena, che check_chain() invalida al montaggio
+    if (block != SB_BLOCK_NUMBER && !get_validity(j->committed_next[block]))
+        return 0;
+
+    page = alloc_page(GFP_NOFS);
+    fbh = alloc_buffer_head(GFP_NOFS);
+    if (!page || !fbh) {
+        if (page)
+            __free_page(page);
+        if (fbh)
+            free_buffer_head(fbh);
+        return -ENOMEM;
+    }
+
+    set_bh_page(fbh, page, 0);
+    fbh->b_bdev = bh->b_bdev;
+    fbh->b_blocknr = block;
+    fbh->b_size = bh->b_size;
+    memcpy(fbh->b_data, bh->b_data, bh->b_size);
+    if (block == SB_BLOCK_NUMBER) {
+        for (i = 0; i < NCHANNELS; i++)
+            journal_set_head((struct onefilefs_sb_info *) fbh->b_data, i, j->committed_head[i][0], j->committed_head[i][1]);
+    }
+    else
+        ((struct bdev_layout *) fbh->b_data)->next_block = j->committed_next[block];
+    set_buffer_mapped(fbh);
+    set_buffer_uptodate(fbh);
+
+    get_bh(fbh);
+    ret = sync_block(sb, fbh, REQ_SYNC | REQ_FUA);
+    put_bh(fbh);
+    free_buffer_head(fbh);
+    __free_page(page);
+
+    if (ret != 0) {
+        printk(KERN_CRIT "%s: [journal] - scrittura della copia committata del blocco %llu fallita\n", MODNAME, (unsigned long long) block);
+        return -EIO;
+    }
+
+    return 1;
+}
+
+// questa funzione rende persistenti i blocchi dati della transazione in costruzione (sottomissione unica, poi attesa)
+static int journal_flush_data(struct journal_info *j) {
+
+    int i;
+    int written;
+    int ret = 0;
+    unsigned long frozen = 0;
+    struct buffer_head *mbh[JOURNAL_MAX_DATA];
+
+    for (i = 0; i < j->nr_data; i++) {
+        mbh[i] = NULL;
+        written = journal_write_frozen(j->sb, j->data_bh[i]);
+        if (written != 0) {
+            if (written < 0)
+                ret = -EIO;
+            __set_bit(i, &frozen);
+            continue;
+        }
+        mbh[i] = submit_block(j->sb, j->data_bh[i], REQ_SYNC);
+    }
+
+    for (i = 0; i < j->nr_data; i++) {
+        if (!test_bit(i, &frozen)) {
+            if (mirror_wait(j->sb, j->data_bh[i], mbh[i]) < 0)
+                ret = -EIO;
+            else
+                clear_block_dirty(j->sb, j->data_bh[i]);
+        }
+        brelse(j->data_bh[i]);
+        j->data_bh[i] = NULL;
+    }
+    j->nr_data = 0;
+
+    return ret;
+}
+
+// questa funzione scrive la transazione in costruzione nel prossimo blocco della regione di journal; il blocco di
+// commit viene scritto con REQ_PREFLUSH | REQ_FUA, quindi raggiunge il supporto persistente dopo i blocchi dati
+// e i blocchi di journal che lo precedono
+static int journal_write_block(struct super_block *sb, struct journal_info *j, unsigned int flags) {
+
+    int i;
+    int ret;
+    int op_flags = REQ_SYNC;
+    struct buffer_head *bh;
+
+    // regione di journal piena: i blocchi più vecchi devono prima essere riportati in-place (quelli della
+    // transazione in costruzione restano nel journal fino al suo commit)
+    if (j->next_seq - j->ckpt_seq >= j->nr_blocks) {
+        ret = journal_flush_inplace(sb, j);
+        if (ret < 0)
+            return ret;
+        if (j->next_seq - j->ckpt_seq >= j->nr_blocks) {
+            printk(KERN_CRIT "%s: [journal] - transazione più grande della regione di journal\n", MODNAME);
+            return -ENOSPC;
+        }
+    }
+
+    // i blocchi dati referenziati dai record devono raggiungere il device prima del blocco di journal
+    ret = journal_flush_data(j);
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: [journal] - scrittura dei blocchi dati fallita\n", MODNAME);
+        return ret;
+    }
+
+    // REQ_PREFLUSH agisce solo sul device del journal: i blocchi dati sugli altri device del volume striped
+    // vengono resi persistenti prima del commit
+    if (flags & JOURNAL_COMMIT) {
+        op_flags |= REQ_PREFLUSH | REQ_FUA;
+        for (i = 1; i < FS_INFO(sb)->nr_stripes; i++) {
+            if (blkdev_issue_flush(FS_INFO(sb)->stripe_bdev[i]) != 0) {
+                printk(KERN_CRIT "%s: [journal] - flush dei blocchi dati fallito\n", MODNAME);
+                return -EIO;
+            }
+        }
+    }
+
+    j->running->header.magic = JOURNAL_MAGIC;
+    j->running->header.seq = j->next_seq;
+    j->running->header.flags = flags;
+    j->running->header.checksum = journal_checksum(j->running);
+
+    bh = sb_getblk(sb, j->start + (j->next_seq % j->nr_blocks));
+    if (!bh)
+        return -EIO;
+
+    lock_buffer(bh);
+    memcpy(bh->b_data, j->running, DEFAULT_BLOCK_SIZE);
+    set_buffer_uptodate(bh);
+    unlock_buffer(bh);
+
+    // forza la scrittura in modo sincrono sul device
+    if (sync_block(sb, bh, op_flags) != 0) {
+        printk(KERN_CRIT "%s: [journal] - scrittura del blocco di journal %llu fallita\n", MODNAME, j->next_seq);
+        brelse(bh);
+        return -EIO;
+    }
+
+    brelse(bh);
+
+    AUDIT printk(KERN_INFO "%s: [journal] - scritto il blocco di journal %llu (%u record)\n", MODNAME, j->next_seq, j->running->header.nr_records);
+
+    j->next_seq++;
+    memset(j->running, 0, DEFAULT_BLOCK_SIZE);
+
+    // dopo il commit i metadati in-place della transazione possono raggiungere il device
+    if (flags & JOURNAL_COMMIT) {
+        bitmap_zero(j->running_map, NBLOCKS);
+        j->txn_seq = j->next_seq;
+        journal_close_op(j);
+    }
+
+    return 0;
+}
+
+// questa funzione riporta in-place tutte le modifiche delle transazioni concluse e libera i relativi blocchi
+// della regione di journal
+static int journal_flush_inplace(struct super_block *sb, struct journal_info *j) {
+
+    int ret;
+    uint64_t seq;
+    struct buffer_head *bh;
+    struct onefilefs_sb_info *sb_disk;
+
+    seq = j->txn_seq;
+    if (seq == j->ckpt_seq && atomic_read(&(FS_INFO(sb)->nr_dirty)) == 0)
+        return 0;
+
+    ret = flush_dirty_blocks(sb);
+    if (ret < 0)
+        return ret;
+    if (seq == j->ckpt_seq)
+        return 0;
+
+    bh = sb_bread(sb, SB_BLOCK_NUMBER);
+    if (!bh)
+        return -EIO;
+    sb_disk = (struct onefilefs_sb_info *) bh->b_data;
+    sb_disk->journal_seq = seq;
+    ret = journal_write_frozen(sb, bh);
+    if (ret == 0)
+        ret = sync_block(sb, bh, REQ_SYNC | REQ_FUA);
+    brelse(bh);
+    if (ret < 0)
+        return -EIO;
+
+    j->ckpt_seq = seq;
+
+    return 0;
+}
+
+// aggiunge un record alla transazione in costruzione
+static int journal_append(struct super_block *sb, struct journal_record *rec) {
+
+    int ret;
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+
+    // transazione più grande di un blocco di journal: il blocco pieno viene scritto senza commit (e conservato,
+    // se contiene i primi record dell'operazione corrente, per poterla annullare)
+    if (j->running->header.nr_records >= JOURNAL_RECORDS) {
+        if (j->op_open && j->next_seq == j->op_start_seq)
+            memcpy(j->op_block, j->running, DEFAULT_BLOCK_SIZE);
+        ret = journal_write_block(sb, j, 0);
+        if (ret < 0)
+            return ret;
+    }
+
+    j->running->records[j->running->header.nr_records++] = *rec;
+
+    return 0;
+}
+
+// registra nel journal il nuovo valore del campo next_block di un blocco (write_lock acquisito)
+int journal_log_block(struct super_block *sb, unsigned int block_num, unsigned int next_block) {
+
+    int ret;
+    struct journal_record rec = { .type = JREC_BLOCK, .block = block_num, .value = next_block };
+
+    ret = journal_apply_record(sb, &rec, 1);
+    if (ret < 0)
+        return ret;
+
+    return journal_append(sb, &rec);
+}
+
+// registra nel journal i nuovi valori di first_valid e last_valid del canale chan (write_lock acquisito)
+int journal_log_sb(struct super_block *sb, unsigned int chan, unsigned int first_valid, unsigned int last_valid) {
+
+    int ret;
+    struct journal_record rec = { .type = JREC_SB, .block = first_valid, .value = last_valid, .chan = chan };
+
+    ret = journal_apply_record(sb, &rec, 1);
+    if (ret < 0)
+        return ret;
+
+    return journal_append(sb, &rec);
+}
+
+// aggiunge un blocco dati (già marcato dirty) a quelli da rendere persistenti prima del commit
+int journal_add_data(struct super_block *sb, struct buffer_head *bh) {
+
+    int i;
+    int ret;
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+
+    for (i = 0; i < j->nr_data; i++) {
+        if (j->data_bh[i] == bh)
+            return 0;
+    }
+
+    if (j->nr_data >= JOURNAL_MAX_DATA) {
+        ret = journal_flush_data(j);
+        if (ret < 0)
+            return ret;
+    }
+
+    get_bh(bh);
+    j->data_bh[j->nr_data++] = bh;
+
+    return 0;
+}
+
+// conserva il contenuto di un blocco valido prima di una sua modifica in-place (write_lock acquisito), così
+// journal_abort_op() può ripristinarlo sotto il seqcount sc dei lettori del messaggio
+int journal_save_data(struct super_block *sb, struct buffer_head *bh, seqcount_mutex_t *sc) {
+
+    int i;
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+
+    for (i = 0; i < j->nr_saved; i++) {
+        if (j->saved[i].bh == bh)
+            return 0;
+    }
+
+    if (j->nr_saved >= JOURNAL_MAX_SAVED)
+        return -ENOSPC;
+
+    journal_begin_op(sb, j);
+    get_bh(bh);
+    memcpy(j->saved[j->nr_saved].data, bh->b_data, DEFAULT_BLOCK_SIZE);
+    j->saved[j->nr_saved].bh = bh;
+    j->saved[j->nr_saved].sc = sc;
+    j->nr_saved++;
+
+    return 0;
+}
+
+// chiude un'operazione nella transazione in costruzione e ne restituisce il numero di sequenza (write_lock acquisito)
+uint64_t journal_end_op(struct super_block *sb) {
+
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+
+    journal_close_op(j);
+    WRITE_ONCE(j->op_seq, j->op_seq + 1);
+
+    return j->op_seq;
+}
+
+// annulla l'operazione corrente dopo un errore (write_lock acquisito): i record registrati dopo l'ultimo
+// journal_end_op() escono dalla transazione in costruzione, i campi modificati in-place tornano ai valori
+// precedenti e i blocchi validi modificati dall'operazione riprendono il contenuto salvato; i buffer ripristinati
+// restano dirty e raggiungono il device con il checkpoint successivo
+int journal_abort_op(struct super_block *sb) {
+
+    int i;
+    int ret = 0;
+    struct journal_saved *saved;
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+
+    if (!j->op_open)
+        return 0;
+
+    if (j->undo_lost) {
+        printk(KERN_CRIT "%s: [journal] - operazione troppo grande per essere annullata\n", MODNAME);
+        journal_close_op(j);
+        return -EIO;
+    }
+
+    // campi next_block e teste dei canali, in ordine inverso di modifica
+    for (i = j->nr_undo - 1; i >= 0; i--) {
+        if (journal_apply_record(sb, &(j->undo[i]), 0) < 0)
+            ret = -EIO;
+    }
+    bitmap_andnot(j->running_map, j->running_map, j->op_map, NBLOCKS);
+
+    // contenuto dei blocchi validi modificati in-place (i lettori vedono il messaggio interamente ripristinato)
+    for (i = j->nr_saved - 1; i >= 0; i--) {
+        saved = &(j->saved[i]);
+        write_seqcount_begin(saved->sc);
+        memcpy(saved->bh->b_data, saved->data, DEFAULT_BLOCK_SIZE);
+        write_seqcount_end(saved->sc);
+        mark_block_dirty(sb, saved->bh);
+    }
+
+    // record dell'operazione: i blocchi di journal già scritti senza commit verranno sovrascritti dai successivi
+    if (j->next_seq != j->op_start_seq) {
+        memcpy(j->running, j->op_block, DEFAULT_BLOCK_SIZE);
+        j->next_seq = j->op_start_seq;
+    }
+    memset(&(j->running->records[j->op_start_nr]), 0, (JOURNAL_RECORDS - j->op_start_nr) * sizeof(struct journal_record));
+    j->running->header.nr_records = j->op_start_nr;
+
+    FS_INFO(sb)->nr_used = j->op_nr_used;
+    journal_close_op(j);
+
+    if (ret < 0)
+        printk(KERN_CRIT "%s: [journal] - ripristino dei metadati dell'operazione annullata fallito\n", MODNAME);
+    else
+        AUDIT printk(KERN_INFO "%s: [journal] - operazione annullata\n", MODNAME);
+
+    return ret;
+}
+
+// commit della transazione in costruzione: un'unica scrittura sequenziale sul journal (write_lock acquisito); le
+// operazioni risultano persistenti solo al completamento della scrittura del blocco di commit con REQ_FUA
+int journal_commit(struct super_block *sb) {
+
+    int ret;
+    uint64_t op_seq;
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+
+    // transazione vuota: i record delle operazioni già chiuse sono contenuti in blocchi di commit persistenti
+    if (j->running->header.nr_records == 0 && j->nr_data == 0) {
+        journal_set_durable(j, j->op_seq);
+        return 0;
+    }
+
+    op_seq = j->op_seq;
+    ret = journal_write_block(sb, j, JOURNAL_COMMIT);
+    if (ret < 0) {
+        WRITE_ONCE(j->error, ret);
+        wake_up_all(&(j->durable_wq));
+        return ret;
+    }
+
+    WRITE_ONCE(j->error, 0);
+    journal_set_durable(j, op_seq);
+
+    return 0;
+}
+
+// commit differito: la transazione viene scritta dal flusher insieme alle operazioni successive
+int journal_commit_async(struct super_block *sb) {
+
+    schedule_delayed_work(&(FS_INFO(sb)->journal.flush_work), msecs_to_jiffies(FS_INFO(sb)->opts.commit_interval));
+
+    return 0;
+}
+
+// commit di un'operazione secondo la politica scelta al montaggio (write_lock acquisito);
+// con COMMIT_GROUP l'attesa della persistenza è a carico del chiamante dopo il rilascio del write_lock
+int journal_commit_mode(struct super_block *sb, unsigned int mode) {
+
+    if (mode == COMMIT_SYNC)
+        return journal_commit(sb);
+
+    return journal_commit_async(sb);
+}
+
+// attende che tutte le operazioni fino a seq (0 = tutte quelle già eseguite) siano persistenti
+int journal_wait_durable(struct super_block *sb, uint64_t seq) {
+
+    int ret;
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+
+    if (seq > READ_ONCE(j->op_seq))
+        return -EINVAL;
+    if (seq == 0)
+        seq = READ_ONCE(j->op_seq);
+    if (READ_ONCE(j->durable_op_seq) >= seq)
+        return 0;
+
+    // il flusher viene anticipato invece di attendere la fine della finestra di raggruppamento
+    mod_delayed_work(system_wq, &(j->flush_work), 0);
+
+    ret = wait_event_interruptible(j->durable_wq, READ_ONCE(j->durable_op_seq) >= seq || READ_ONCE(j->error) != 0);
+    if (ret != 0)
+        return ret;
+    if (READ_ONCE(j->durable_op_seq) < seq)
+        return READ_ONCE(j->error);
+
+    return 0;
+}
+
+// rende persistenti tutte le operazioni eseguite (write_lock acquisito): i blocchi dati della transazione vengono
+// scritti e attesi, quindi il blocco di commit viene scritto con REQ_PREFLUSH | REQ_FUA; i metadati in-place sono
+// già ricostruibili dal journal e vengono riportati sul device dal checkpoint
+int journal_sync(struct super_block *sb) {
+
+    return journal_commit(sb);
+}
+
+// checkpoint: commit della transazione corrente e scrittura in-place dei metadati (write_lock acquisito)
+int journal_checkpoint(struct super_block *sb) {
+
+    int ret;
+
+    ret = journal_commit(sb);
+    if (ret < 0)
+        return ret;
+
+    return journal_flush_inplace(sb, &(FS_INFO(sb)->journal));
+}
+
+// flusher: commit sincrono di tutte le operazioni in attesa con un'unica scrittura sul journal
+static void journal_flush_work(struct work_struct *work) {
+
+    int ret;
+    struct journal_info *j = container_of(to_delayed_work(work), struct journal_info, flush_work);
+
+    mutex_lock(&(FS_INFO(j->sb)->write_lock));
+    ret = journal_commit(j->sb);
+    if (ret < 0)
+        printk(KERN_CRIT "%s: [journal] - flush delle operazioni asincrone fallito\n", MODNAME);
+    mutex_unlock(&(FS_INFO(j->sb)->write_lock));
+}
+
+// riapplica le transazioni concluse non ancora riportate in-place (montaggio dopo un crash)
+static int journal_replay(struct super_block *sb, struct journal_info *j) {
+
+    int i;
+    int ret;
+    uint64_t seq;
+    uint64_t end;
+    struct buffer_head *bh;
+    struct journal_block *jblk;
+
+    // prima passata: ricerca dell'ultimo blocco di commit integro
+    end = j->ckpt_seq;
+    for (seq = j->ckpt_seq; seq < j->ckpt_seq + j->nr_blocks; seq++) {
+        bh = sb_bread(sb, j->start + (seq % j->nr_blocks));
+        if (!bh)
+            return -EIO;
+        jblk = (struct journal_block *) bh->b_data;
+        if (!journal_block_valid(jblk, seq)) {
+            brelse(bh);
+            break;
+        }
+        if (jblk->header.flags & JOURNAL_COMMIT)
+            end = seq + 1;
+        brelse(bh);
+    }
+
+    // seconda passata: riapplicazione dei record (le transazioni incomplete vengono scartate)
+    for (seq = j->ckpt_seq; seq < end; seq++) {
+        bh = sb_bread(sb, j->start + (seq % j->nr_blocks));
+        if (!bh)
+            return -EIO;
+        jblk = (struct journal_block *) bh->b_data;
+        for (i = 0; i < jblk->header.nr_records; i++) {
+            ret = journal_apply_record(sb, &(jblk->records[i]), 0);
+            if (ret < 0) {
+                brelse(bh);
+                return ret;
+            }
+        }
+        brelse(bh);
+    }
+
+    if (end != j->ckpt_seq)
+        printk(KERN_INFO "%s: [journal] - riapplicati %llu blocchi di journal\n", MODNAME, end - j->ckpt_seq);
+
+    j->next_seq = end;
+    j->txn_seq = end;
+
+    return journal_flush_inplace(sb, j);
+}
+
+// rilascio delle strutture del journal
+static void journal_free(struct journal_info *j) {
+
+    int i;
+
+    kfree(j->running);
+    j->running = NULL;
+    bitmap_free(j->running_map);
+    j->running_map = NULL;
+    kfree(j->committed_next);
+    j->committed_next = NULL;
+    kfree(j->op_block);
+    j->op_block = NULL;
+    kfree(j->undo);
+    j->undo = NULL;
+    bitmap_free(j->op_map);
+    j->op_map = NULL;
+    for (i = 0; i < JOURNAL_MAX_SAVED; i++) {
+        kfree(j->saved[i].data);
+        j->saved[i].data = NULL;
+    }
+}
+
+// inizializzazione del journal al montaggio
+int journal_load(struct super_block *sb) {
+
+    int i;
+    int ret;
+    struct buffer_head *bh;
+    struct onefilefs_sb_info *sb_disk;
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+
+    bh = sb_bread(sb, SB_BLOCK_NUMBER);
+    if (!bh)
+        return -EIO;
+    sb_disk = (struct onefilefs_sb_info *) bh->b_data;
+    j->start = sb_disk->journal_start;
+    j->nr_blocks = sb_disk->journal_blocks;
+    j->ckpt_seq = sb_disk->journal_seq;
+    j->next_seq = sb_disk->journal_seq;
+    j->txn_seq = sb_disk->journal_seq;
+    brelse(bh);
+
+    if (j->nr_blocks == 0 || j->start < NBLOCKS || j->start + j->nr_blocks > FS_INFO(sb)->nr_dev_blocks) {
+        printk(KERN_CRIT "%s: [journal] - regione di journal non valida, è necessario riformattare il device\n", MODNAME);
+        return -EINVAL;
+    }
+
+    j->sb = sb;
+    j->nr_data = 0;
+    j->op_seq = 0;
+    j->op_open = 0;
+    j->nr_undo = 0;
+    j->undo_lost = 0;
+    j->nr_saved = 0;
+    j->durable_op_seq = 0;
+    j->error = 0;
+    init_waitqueue_head(&(j->durable_wq));
+    INIT_DELAYED_WORK(&(j->flush_work), journal_flush_work);
+    j->running = kzalloc(DEFAULT_BLOCK_SIZE, GFP_KERNEL);
+    j->running_map = bitmap_zalloc(NBLOCKS, GFP_KERNEL);
+    j->committed_next = kcalloc(NBLOCKS, sizeof(unsigned int), GFP_KERNEL);
+    j->op_block = kzalloc(DEFAULT_BLOCK_SIZE, GFP_KERNEL);
+    j->undo = kcalloc(JOURNAL_MAX_UNDO, sizeof(struct journal_record), GFP_KERNEL);
+    j->op_map = bitmap_zalloc(NBLOCKS, GFP_KERNEL);
+    if (!j->running || !j->running_map || !j->committed_next || !j->op_block || !j->undo || !j->op_map) {
+        ret = -ENOMEM;
+        goto load_exit;
+    }
+    for (i = 0; i < JOURNAL_MAX_SAVED; i++) {
+        j->saved[i].bh = NULL;
+        j->saved[i].data = kmalloc(DEFAULT_BLOCK_SIZE, GFP_KERNEL);
+        if (!j->saved[i].data) {
+            ret = -ENOMEM;
+            goto load_exit;
+        }
+    }
+
+    ret = journal_replay(sb, j);
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: [journal] - replay del journal fallito\n", MODNAME);
+        drop_dirty_blocks(sb);
+        goto load_exit;
+    }
+
+    return 0;
+
+load_exit:
+    journal_free(j);
+    return ret;
+}
+
+// checkpoint finale e rilascio del journal allo smontaggio
+void journal_unload(struct super_block *sb) {
+
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+
+    if (!j->running)
+        return;
+
+    mutex_lock(&(FS_INFO(sb)->write_lock));
+    if (journal_checkpoint(sb) < 0)
+        printk(KERN_CRIT "%s: [journal] - checkpoint finale fallito\n", MODNAME);
+    mutex_unlock(&(FS_INFO(sb)->write_lock));
+
+    cancel_delayed_work_sync(&(j->flush_work));
+    drop_dirty_blocks(sb);
+
+    journal_free(j);
+}
@@ -0,0 +1,264 @@
+#include <linux/blkdev.h>
+#include <linux/buffer_head.h>
+#include <linux/fs.h>
+#include <linux/module.h>
+#include <linux/string.h>
+
+#include "utils_header.h"
+
+/*
+    Mirror: con l'opzione di montaggio mirror=dev ogni blocco del volume (blocchi dati, superblocco,
+    inode e journal) viene scritto anche sul device di mirror, allo stesso indice di blocco. La copia
+    viene sottomessa insieme alla scrittura sul device del volume e l'operazione si considera completata
+    quando quorum copie (1 o 2) sono state scritte con successo, attendendo sempre per prima quella sul device
+    del volume. Il device del montaggio è quello di riferimento: al montaggio il mirror viene riallineato
+    copiandovi i blocchi utilizzati dal volume (blocchi dati, superblocco, inode e journal), dopodiché le
+    letture dei blocchi dati non presenti in memoria vengono servite dalla copia meno occupata.
+*/
+
+#define MIRROR_MODE (FMODE_READ | FMODE_WRITE | FMODE_EXCL)
+
+// sottomette la scrittura della copia di mirror del buffer con i flag op_flags (nessuna scrittura se la copia è
+// già aggiornata) e restituisce il buffer di mirror, referenziato fino a mirror_wait(); NULL se il volume non è
+// replicato o se la copia non è stata sottomessa
+struct buffer_head *mirror_write(struct super_block *sb, struct buffer_head *bh, int op_flags) {
+
+    struct buffer_head *mbh;
+    struct filesystem_info *fsi = FS_INFO(sb);
+
+    if (fsi->mirror_bdev == NULL)
+        return NULL;
+
+    mbh = __getblk(fsi->mirror_bdev, bh->b_blocknr, sb->s_blocksize);
+    if (!mbh) {
+        printk(KERN_CRIT "%s: [mirror] - impossibile sottomettere la copia del blocco %llu\n", MODNAME, (unsigned long long) bh->b_blocknr);
+        return NULL;
+    }
+
+    // una copia uguale, non dirty e ancora uptodate dopo l'attesa del lock è già stata scritta con successo
+    lock_buffer(mbh);
+    if (buffer_uptodate(mbh) && !buffer_dirty(mbh) && memcmp(mbh->b_data, bh->b_data, sb->s_blocksize) == 0) {
+        unlock_buffer(mbh);
+        return mbh;
+    }
+    memcpy(mbh->b_data, bh->b_data, sb->s_blocksize);
+    set_buffer_uptodate(mbh);
+    mark_buffer_dirty(mbh);
+    unlock_buffer(mbh);
+
+    write_dirty_buffer(mbh, op_flags);
+
+    return mbh;
+}
+
+// attende la scrittura del buffer e della sua copia di mirror mbh (restituita da submit_block()) fino al
+// raggiungimento del quorum e rilascia mbh: restituisce le copie scritte con successo (MIRROR_PRIMARY,
+// MIRROR_COPY), di cui il chiamante deve svuotare la cache, oppure -EIO; il device del volume è quello di
+// riferimento, quindi con quorum 1 la copia di mirror viene attesa solo se la scrittura sul device del volume è
+// fallita, e una copia non sottomessa (mbh NULL) non contribuisce al quorum
+int mirror_wait(struct super_block *sb, struct buffer_head *bh, struct buffer_head *mbh) {
+
+    int ok = 0;
+    int copies = 0;
+    struct filesystem_info *fsi = FS_INFO(sb);
+
+    wait_on_buffer(bh);
+    if (buffer_uptodate(bh)) {
+        copies |= MIRROR_PRIMARY;
+        ok++;
+    }
+    else
+        printk(KERN_CRIT "%s: [mirror] - scrittura del blocco %llu fallita sul device %s\n", MODNAME, (unsigned long long) bh->b_blocknr, sb->s_id);
+
+    if (fsi->mirror_bdev == NULL)
+        return ok ? copies : -EIO;
+
+    if (ok < fsi->opts.quorum && mbh) {
+        wait_on_buffer(mbh);
+        if (buffer_uptodate(mbh)) {
+            copies |= MIRROR_COPY;
+            ok++;
+        }
+        else
+            printk(KERN_CRIT "%s: [mirror] - scrittura del blocco %llu fallita sul device di mirror\n", MODNAME, (unsigned long long) bh->b_blocknr);
+    }
+    brelse(mbh);
+
+    return ok >= fsi->opts.quorum ? copies : -EIO;
+}
+
+// svuota la cache dei device che hanno ricevuto le copie indicate da copies (restituite da mirror_wait())
+int mirror_flush(struct super_block *sb, int copies) {
+
+    int i;
+    int ret = 0;
+    struct filesystem_info *fsi = FS_INFO(sb);
+
+    for (i = 0; (copies & MIRROR_PRIMARY) && i < fsi->nr_stripes; i++) {
+        if (blkdev_issue_flush(fsi->stripe_bdev[i]) != 0)
+            ret = -EIO;
+    }
+    if ((copies & MIRROR_COPY) && fsi->mirror_bdev && blkdev_issue_flush(fsi->mirror_bdev) != 0)
+        ret = -EIO;
+
+    return ret;
+}
+
+// sottomette la scrittura di un buffer e della sua copia di mirror con i flag op_flags (il completamento va
+// atteso con mirror_wait(), a cui va passato il buffer di mirror restituito)
+struct buffer_head *submit_block(struct super_block *sb, struct buffer_head *bh, int op_flags) {
+
+    struct buffer_head *mbh;
+
+    mbh = mirror_write(sb, bh, op_flags);
+    set_buffer_dirty(bh);
+    write_dirty_buffer(bh, op_flags);
+
+    return mbh;
+}
+
+// scrittura sincrona di un buffer su entrambe le copie con i flag op_flags (sostituisce sync_dirty_buffer()):
+// i blocchi di commit del journal vengono scritti con REQ_PREFLUSH | REQ_FUA
+int sync_block(struct super_block *sb, struct buffer_head *bh, int op_flags) {
+
+    struct buffer_head *mbh;
+
+    mbh = submit_block(sb, bh, op_flags);
+
+    return mirror_wait(sb, bh, mbh) < 0 ? -EIO : 0;
+}
+
+// lettura di un blocco dati dalla copia di mirror se questa è già in memoria o meno occupata del device del
+// volume (NULL se il blocco va letto dal device del volume)
+struct buffer_head *mirror_read(struct super_block *sb, struct block_device *bdev, unsigned int block_num) {
+
+    struct buffer_head *bh;
+    struct buffer_head *mbh;
+    struct filesystem_info *fsi = FS_INFO(sb);
+
+    // un blocco con modifiche non ancora riportate sul mirror può essere letto solo dal device del volume
+    if (fsi->mirror_bdev == NULL || block_num >= fsi->nr_dev_blocks || test_bit(block_num, fsi->dirty_map))
+        return NULL;
+
+    bh = __getblk(bdev, block_num, sb->s_blocksize);
+    if (!bh)
+        return NULL;
+    if (buffer_uptodate(bh))
+        return bh;
+
+    mbh = __find_get_block(fsi->mirror_bdev, block_num, sb->s_blocksize);
+    if (!mbh || !buffer_uptodate(mbh)) {
+        brelse(mbh);
+        if (atomic_read(&(fsi->mirror_reads[1])) >= atomic_read(&(fsi->mirror_reads[0]))) {
+            brelse(bh);
+            return NULL;
+        }
+        atomic_inc(&(fsi->mirror_reads[1]));
+        mbh = __bread(fsi->mirror_bdev, block_num, sb->s_blocksize);
+        atomic_dec(&(fsi->mirror_reads[1]));
+        if (!mbh) {
+            brelse(bh);
+            return NULL;
+        }
+    }
+
+    lock_buffer(bh);
+    if (!buffer_uptodate(bh)) {
+        memcpy(bh->b_data, mbh->b_data, sb->s_blocksize);
+        set_buffer_uptodate(bh);
+    }
+    unlock_buffer(bh);
+    brelse(mbh);
+
+    return bh;
+}
+
+// riallineamento del mirror: vengono copiati sul device di mirror i blocchi utilizzati dal volume (blocchi dati,
+// superblocco, inode e regione di journal), saltando quelli già uguali
+static int mirror_resync(struct super_block *sb) {
+
+    int ret = 0;
+    sector_t block_num;
+    sector_t journal_start;
+    sector_t journal_end;
+    struct blk_plug plug;
+    struct buffer_head *bh;
+    struct onefilefs_sb_info *sb_disk;
+    struct filesystem_info *fsi = FS_INFO(sb);
+
+    bh = sb_bread(sb, SB_BLOCK_NUMBER);
+    if (!bh)
+        return -EIO;
+    sb_disk = (struct onefilefs_sb_info *) bh->b_data;
+    journal_start = sb_disk->journal_start;
+    journal_end = min_t(sector_t, journal_start + sb_disk->journal_blocks, fsi->nr_dev_blocks);
+    brelse(bh);
+
+    blk_start_plug(&plug);
+    for (block_num = 0; block_num < journal_end; block_num++) {
+        // i blocchi tra la fine dei blocchi dati e l'inizio del journal non vengono mai scritti
+        if (block_num >= NBLOCKS && block_num < journal_start)
+            block_num = journal_start;
+        bh = __bread(block_bdev(sb, block_num), block_num, sb->s_blocksize);
+        if (!bh) {
+            ret = -EIO;
+            break;
+        }
+        brelse(mirror_write(sb, bh, REQ_SYNC));
+        brelse(bh);
+    }
+    blk_finish_plug(&plug);
+
+    if (sync_blockdev(fsi->mirror_bdev) != 0 || blkdev_issue_flush(fsi->mirror_bdev) != 0)
+        ret = -EIO;
+
+    return ret;
+}
+
+// apertura del device di mirror indicato dall'opzione mirror= e riallineamento della copia
+int mirror_open(struct super_block *sb) {
+
+    int ret;
+    struct block_device *bdev;
+    struct filesystem_info *fsi = FS_INFO(sb);
+
+    if (fsi->opts.mirror == NULL)
+        return 0;
+
+    bdev = blkdev_get_by_path(fsi->opts.mirror, MIRROR_MODE, sb);
+    if (IS_ERR(bdev)) {
+        printk(KERN_CRIT "%s: [mirror] - impossibile aprire il device %s\n", MODNAME, fsi->opts.mirror);
+        return PTR_ERR(bdev);
+    }
+
+    if (set_blocksize(bdev, sb->s_blocksize) != 0 || (i_size_read(bdev->bd_inode) >> sb->s_blocksize_bits) < fsi->nr_dev_blocks) {
+        printk(KERN_CRIT "%s: [mirror] - il device %s è più piccolo del volume\n", MODNAME, fsi->opts.mirror);
+        blkdev_put(bdev, MIRROR_MODE);
+        return -EINVAL;
+    }
+    fsi->mirror_bdev = bdev;
+
+    ret = mirror_resync(sb);
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: [mirror] - riallineamento del device %s fallito\n", MODNAME, fsi->opts.mirror);
+        mirror_close(sb);
+        return ret;
+    }
+
+    LOG printk("%s: [mirror] - volume replicato su %s (quorum %u)\n", MODNAME, fsi->opts.mirror, fsi->opts.quorum);
+
+    return 0;
+}
+
+// chiusura del device di mirror (i buffer dirty sono già stati scritti dal checkpoint finale)
+void mirror_close(struct super_block *sb) {
+
+    struct filesystem_info *fsi = FS_INFO(sb);
+
+    if (fsi->mirror_bdev == NULL)
+        return;
+
+    sync_blockdev(fsi->mirror_bdev);
+    blkdev_put(fsi->mirror_bdev, MIRROR_MODE);
+    fsi->mirror_bdev = NULL;
+}
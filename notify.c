@@ -0,0 +1,158 @@
+#include <linux/anon_inodes.h>
+#include <linux/fs.h>
+#include <linux/kfifo.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+
+#include "utils_header.h"
+
+/*
+    File descriptor di notifica: ogni fd restituito da IOCTL_NOTIFY_FD possiede una coda di eventi
+    (operazione, blocco, sequenza) alimentata dalle operazioni di scrittura, che può essere letta
+    a blocchi di più eventi oppure attesa con poll/epoll, senza dover interrogare get_data() su
+    tutti gli offset. Se la coda si riempie gli eventi successivi vengono scartati e al lettore
+    viene consegnato un evento NOTIFY_OVERFLOW, che indica di riallineare il proprio stato.
+*/
+
+#define NOTIFY_QUEUE_SIZE 256      // eventi per fd (potenza di 2)
+#define NOTIFY_READ_BATCH 32       // eventi consegnati al più da una singola read
+
+struct notify_queue {
+    struct list_head list;          // elemento della notify_list del montaggio
+    struct super_block *sb;         // montaggio a cui è associato l'fd (mantenuto attivo fino alla chiusura)
+    spinlock_t lock;
+    DECLARE_KFIFO(fifo, struct blocklevel_event, NOTIFY_QUEUE_SIZE);
+    unsigned int overflow;          // eventi scartati fino alla prossima lettura
+    wait_queue_head_t wq;
+};
+
+// accoda l'evento a tutti gli fd di notifica aperti
+void notify_event(struct super_block *sb, unsigned int op, unsigned int block, uint64_t seq) {
+
+    struct notify_queue *q;
+    struct blocklevel_event ev = { .op = op, .block = block, .seq = seq };
+    struct blocklevel_event lost = { .op = NOTIFY_OVERFLOW, .block = -1, .seq = seq };
+
+    spin_lock(&(FS_INFO(sb)->notify_lock));
+    list_for_each_entry(q, &(FS_INFO(sb)->notify_list), list) {
+        spin_lock(&(q->lock));
+        if (!q->overflow) {
+            // l'ultimo posto libero è riservato all'evento di overflow
+            if (kfifo_avail(&(q->fifo)) > 1) {
+                kfifo_put(&(q->fifo), ev);
+            }
+            else {
+                kfifo_put(&(q->fifo), lost);
+                q->overflow = 1;
+            }
+        }
+        spin_unlock(&(q->lock));
+        wake_up_interruptible(&(q->wq));
+    }
+    spin_unlock(&(FS_INFO(sb)->notify_lock));
+}
+
+static ssize_t notify_read(struct file *file, char __user *buf, size_t count, loff_t *pos) {
+
+    int ret;
+    unsigned int n;
+    struct notify_queue *q = file->private_data;
+    struct blocklevel_event events[NOTIFY_READ_BATCH];
+
+    if (count < sizeof(struct blocklevel_event))
+        return -EINVAL;
+
+    while (kfifo_is_empty(&(q->fifo))) {
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(q->wq, !kfifo_is_empty(&(q->fifo)));
+        if (ret != 0)
+            return ret;
+    }
+
+    n = min_t(size_t, count / sizeof(struct blocklevel_event), NOTIFY_READ_BATCH);
+
+    spin_lock(&(q->lock));
+    n = kfifo_out(&(q->fifo), events, n);
+    q->overflow = 0;
+    spin_unlock(&(q->lock));
+
+    if (copy_to_user(buf, events, n * sizeof(struct blocklevel_event)))
+        return -EFAULT;
+
+    return n * sizeof(struct blocklevel_event);
+}
+
+static __poll_t notify_poll(struct file *file, poll_table *wait) {
+
+    struct notify_queue *q = file->private_data;
+
+    poll_wait(file, &(q->wq), wait);
+
+    if (!kfifo_is_empty(&(q->fifo)))
+        return EPOLLIN | EPOLLRDNORM;
+
+    return 0;
+}
+
+static int notify_release(struct inode *inode, struct file *file) {
+
+    struct notify_queue *q = file->private_data;
+    struct super_block *sb = q->sb;
+
+    spin_lock(&(FS_INFO(sb)->notify_lock));
+    list_del(&(q->list));
+    spin_unlock(&(FS_INFO(sb)->notify_lock));
+
+    kfree(q);
+    deactivate_super(sb);
+
+    return 0;
+}
+
+static const struct file_operations notify_fops = {
+    .owner = THIS_MODULE,
+    .read = notify_read,
+    .poll = notify_poll,
+    .release = notify_release,
+    .llseek = noop_llseek,
+};
+
+// crea un nuovo fd di notifica sugli eventi del montaggio sb e ne restituisce il numero
+int notify_open(struct super_block *sb) {
+
+    int fd;
+    struct notify_queue *q;
+
+    q = kzalloc(sizeof(struct notify_queue), GFP_KERNEL);
+    if (!q)
+        return -ENOMEM;
+
+    spin_lock_init(&(q->lock));
+    INIT_KFIFO(q->fifo);
+    init_waitqueue_head(&(q->wq));
+    q->sb = sb;
+
+    // il montaggio resta attivo finché l'fd è aperto (chiamata da un file aperto sul montaggio, quindi s_active > 0)
+    atomic_inc(&(sb->s_active));
+
+    spin_lock(&(FS_INFO(sb)->notify_lock));
+    list_add_tail(&(q->list), &(FS_INFO(sb)->notify_list));
+    spin_unlock(&(FS_INFO(sb)->notify_lock));
+
+    fd = anon_inode_getfd("[blocklevel-notify]", &notify_fops, q, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        spin_lock(&(FS_INFO(sb)->notify_lock));
+        list_del(&(q->list));
+        spin_unlock(&(FS_INFO(sb)->notify_lock));
+        kfree(q);
+        deactivate_super(sb);
+    }
+
+    return fd;
+}
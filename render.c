@@ -0,0 +1,305 @@
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/refcount.h>
+#include <linux/slab.h>
+#include <linux/srcu.h>
+#include <linux/uio.h>
+
+#include "utils_header.h"
+
+/*
+    Copia renderizzata del contenuto di ciascun canale (i messaggi validi seguiti dal fine riga, esattamente come
+    restituiti dalla read), da cui vengono servite le letture senza scorrere la catena dei blocchi. Ogni canale ha
+    un contatore di generazione incrementato da ogni put, invalidazione o aggiornamento in-place e un secondo
+    contatore incrementato solo dalle modifiche che non sono semplici accodamenti: se è cambiato solo il primo la
+    copia viene estesa con i messaggi collegati dopo l'ultimo renderizzato, altrimenti viene ricostruita
+    dall'inizio della catena. La memoria di ciascun canale è limitata dall'opzione di montaggio render_cache=
+    (0 la disabilita): un contenuto più grande viene servito scorrendo la catena fino alla modifica successiva.
+    Il lock della copia è mantenuto solo per aggiornarla e prenderne un riferimento: la copia nel buffer utente
+    avviene fuori dal lock, e una ricostruzione mentre la memoria è in uso da un lettore ne alloca una nuova.
+*/
+
+// dimensione massima del contenuto di un canale: ogni blocco dati con il proprio fine riga
+#define RENDER_MAX_SIZE ((size_t) (NBLOCKS-2) * (DATA_SIZE + 1))
+
+// porzione della copia visibile a un lettore: memoria referenziata e dimensioni al momento dell'acquisizione
+struct render_view {
+    struct render_snap *snap;
+    size_t size;
+    unsigned int nr;
+};
+
+// registra una modifica del contenuto del canale chan (write_lock acquisito); rewrite indica che non si tratta di
+// un accodamento in coda alla catena (invalidazione o aggiornamento in-place di un messaggio)
+void render_bump(struct super_block *sb, unsigned int chan, int rewrite) {
+
+    struct channel_info *ch = &(FS_INFO(sb)->chan[chan]);
+
+    if (rewrite)
+        smp_store_release(&(ch->rewrite_gen), ch->rewrite_gen + 1);
+    smp_store_release(&(ch->gen), ch->gen + 1);
+}
+
+// alloca la memoria di una copia di cap byte, referenziata dalla sola copia del canale
+static struct render_snap *render_alloc(size_t cap) {
+
+    struct render_snap *snap;
+
+    snap = kmalloc(sizeof(struct render_snap), GFP_KERNEL);
+    if (snap == NULL)
+        return NULL;
+    snap->buf = kvmalloc(cap, GFP_KERNEL);
+    snap->entries = kvmalloc_array(NBLOCKS-2, sizeof(struct render_entry), GFP_KERNEL);
+    if (snap->buf == NULL || snap->entries == NULL) {
+        kvfree(snap->buf);
+        kvfree(snap->entries);
+        kfree(snap);
+        return NULL;
+    }
+    refcount_set(&(snap->ref), 1);
+
+    return snap;
+}
+
+// rilascia un riferimento alla memoria di una copia (liberata dall'ultimo)
+static void render_put(struct render_snap *snap) {
+
+    if (snap == NULL || !refcount_dec_and_test(&(snap->ref)))
+        return;
+    kvfree(snap->buf);
+    kvfree(snap->entries);
+    kfree(snap);
+}
+
+// indice del primo messaggio della copia con sequenza maggiore di seq
+static unsigned int render_find(struct render_view *v, uint64_t seq) {
+
+    unsigned int mid;
+    unsigned int lo = 0;
+    unsigned int hi = v->nr;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (v->snap->entries[mid].seq <= seq)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+// indice del messaggio della copia che contiene il byte precedente all'offset pos (pos > 0)
+static unsigned int render_find_off(struct render_view *v, size_t pos) {
+
+    unsigned int mid;
+    unsigned int lo = 0;
+    unsigned int hi = v->nr;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (v->snap->entries[mid].off < pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo - 1;
+}
+
+static inline size_t render_end(struct render_view *v, unsigned int i) {
+
+    return (i + 1 < v->nr) ? v->snap->entries[i + 1].off : v->size;
+}
+
+// porta la copia del canale chan alla generazione corrente (lock della copia acquisito): restituisce -ENODATA se
+// la copia non è disponibile
+static int render_update(struct super_block *sb, unsigned int chan, struct render_cache *rc) {
+
+    int ret = 0;
+    int length;
+    int srcu_idx;
+    size_t data_len;
+    unsigned int block;
+    unsigned int hops = 0;
+    uint64_t gen;
+    uint64_t rewrite_gen;
+    uint64_t seq;
+    uint64_t last_seq;
+    struct channel_info *ch = &(FS_INFO(sb)->chan[chan]);
+    struct onefilefs_sb_info *sb_disk;
+    struct bdev_layout *bdev_blk;
+    struct render_snap *snap;
+
+    gen = smp_load_acquire(&(ch->gen));
+    rewrite_gen = smp_load_acquire(&(ch->rewrite_gen));
+
+    if (rc->snap == NULL) {
+        rc->cap = min_t(size_t, (size_t) FS_INFO(sb)->opts.render_cache * 1024, RENDER_MAX_SIZE);
+        rc->snap = render_alloc(rc->cap);
+        if (rc->snap == NULL)
+            return -ENODATA;
+        rc->rewrite_gen = rewrite_gen + 1;
+    }
+
+    // dopo invalidazioni o aggiornamenti in-place la copia viene ricostruita dall'inizio della catena (in una nuova
+    // memoria se quella attuale è ancora in uso da un lettore); gli accodamenti scrivono oltre la porzione già
+    // visibile ai lettori, quindi possono estendere la memoria condivisa
+    if (rc->rewrite_gen != rewrite_gen) {
+        if (refcount_read(&(rc->snap->ref)) > 1) {
+            snap = render_alloc(rc->cap);
+            if (snap == NULL)
+                return -ENODATA;
+            render_put(rc->snap);
+            rc->snap = snap;
+        }
+        rc->size = 0;
+        rc->nr = 0;
+        rc->full = 0;
+        rc->rewrite_gen = rewrite_gen;
+    }
+    else if (rc->full) {
+        return -ENODATA;
+    }
+    else if (rc->gen == gen) {
+        return 0;
+    }
+
+    last_seq = smp_load_acquire(&(ch->msg_seq));
+    srcu_idx = srcu_read_lock(&(FS_INFO(sb)->srcu));
+
+    sb_disk = get_sb_info(sb);
+    if (sb_disk == NULL) {
+        ret = -EIO;
+        goto render_exit;
+    }
+
+    // in assenza di invalidazioni l'ultimo messaggio renderizzato è ancora collegato: si riprende dal successivo
+    block = chan_first_valid(sb_disk, chan);
+    if (rc->nr > 0) {
+        bdev_blk = get_block(sb, blk_offset(rc->last_block));
+        if (bdev_blk == NULL) {
+            ret = -EIO;
+            goto render_exit;
+        }
+        block = get_block_num(READ_ONCE(bdev_blk->next_block));
+    }
+
+    while (block < NBLOCKS-2 && rc->nr < NBLOCKS-2 && hops++ < NBLOCKS-2) {
+        bdev_blk = get_block(sb, blk_offset(block));
+        if (bdev_blk == NULL) {
+            ret = -EIO;
+            goto render_exit;
+        }
+        seq = READ_ONCE(FS_INFO(sb)->block_seq[block]);
+        if (seq > last_seq)
+            break;
+
+        length = copy_message_to_kernel(sb, block, bdev_blk, rc->snap->buf + rc->size, 0, rc->cap - rc->size, &data_len);
+        if (length < 0) {
+            ret = length;
+            goto render_exit;
+        }
+
+        // contenuto più grande del limite: letture servite dalla catena fino alla prossima ricostruzione
+        if (data_len < length || rc->size + length >= rc->cap) {
+            rc->full = 1;
+            ret = -ENODATA;
+            goto render_exit;
+        }
+        rc->snap->buf[rc->size + length] = '\n';
+        rc->snap->entries[rc->nr].seq = seq;
+        rc->snap->entries[rc->nr].off = rc->size;
+        rc->nr++;
+        rc->size += length + 1;
+        rc->last_block = block;
+
+        block = get_block_num(READ_ONCE(bdev_blk->next_block));
+    }
+    rc->gen = gen;
+
+render_exit:
+    srcu_read_unlock(&(FS_INFO(sb)->srcu), srcu_idx);
+    return ret;
+}
+
+// serve la read del file f dalla copia renderizzata del canale, fino al messaggio last_seq: restituisce i byte
+// copiati nell'iteratore oppure -ENODATA se la copia non è disponibile (disabilitata o più grande del limite)
+ssize_t render_read(struct super_block *sb, struct onefilefs_file *f, struct iov_iter *to, uint64_t last_seq) {
+
+    ssize_t ret;
+    size_t start;
+    size_t end;
+    size_t pos;
+    size_t n;
+    unsigned int i;
+    unsigned int j;
+    unsigned int k;
+    struct render_view v;
+    struct render_cache *rc = &(FS_INFO(sb)->chan[f->chan].render);
+
+    if (FS_INFO(sb)->opts.render_cache == 0)
+        return -ENODATA;
+
+    // aggiornamento della copia e riferimento alla porzione attuale, copiata nel buffer utente fuori dal lock
+    mutex_lock(&(rc->lock));
+    ret = render_update(sb, f->chan, rc);
+    if (ret < 0) {
+        mutex_unlock(&(rc->lock));
+        return ret;
+    }
+    v.snap = rc->snap;
+    v.size = rc->size;
+    v.nr = rc->nr;
+    refcount_inc(&(v.snap->ref));
+    mutex_unlock(&(rc->lock));
+
+    // messaggi successivi all'ultimo consegnato al lettore, fino a last_seq
+    i = render_find(&v, f->seq);
+    j = render_find(&v, last_seq);
+    if (i >= j)
+        goto render_read_exit;
+    start = v.snap->entries[i].off;
+    end = (j < v.nr) ? v.snap->entries[j].off : v.size;
+    if (v.snap->entries[i].seq == f->partial_seq)
+        start += min_t(size_t, f->partial_off, render_end(&v, i) - start - 1);
+
+    n = copy_to_iter(v.snap->buf + start, end - start, to);
+    if (n == 0) {
+        ret = -EFAULT;
+        goto render_read_exit;
+    }
+    AUDIT printk(KERN_INFO "%s: [render_read()] - canale %u, copiati %zu byte dalla copia renderizzata\n", MODNAME, f->chan, n);
+
+    // posizione del lettore: ultimo messaggio consegnato per intero ed eventuale porzione del successivo
+    pos = start + n;
+    k = render_find_off(&v, pos);
+    if (pos == render_end(&v, k)) {
+        f->seq = v.snap->entries[k].seq;
+        f->partial_seq = 0;
+        f->partial_off = 0;
+    }
+    else {
+        if (k > i)
+            f->seq = v.snap->entries[k - 1].seq;
+        f->partial_seq = v.snap->entries[k].seq;
+        f->partial_off = pos - v.snap->entries[k].off;
+    }
+    ret = n;
+
+render_read_exit:
+    render_put(v.snap);
+    return ret;
+}
+
+// rilascio delle copie renderizzate dei canali
+void render_free(struct super_block *sb) {
+
+    int i;
+
+    for (i = 0; i < NCHANNELS; i++) {
+        render_put(FS_INFO(sb)->chan[i].render.snap);
+        FS_INFO(sb)->chan[i].render.snap = NULL;
+    }
+}
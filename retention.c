@@ -0,0 +1,165 @@
+#include <linux/buffer_head.h>
+#include <linux/fs.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/srcu.h>
+#include <linux/timekeeping.h>
+#include <linux/workqueue.h>
+
+#include "utils_header.h"
+
+/*
+    Retention dei messaggi: con le opzioni di montaggio ttl= (secondi) e max_msgs= un worker periodico
+    elimina dalla testa della catena di ogni canale i messaggi scaduti o in eccesso (max_msgs si applica
+    a ciascun canale). I messaggi vengono eliminati a
+    gruppi di al più RETENTION_BATCH: ogni gruppo viene scollegato con un'unica modifica del superblocco,
+    attende un solo grace period e viene reso persistente con un solo commit del journal.
+*/
+
+static int retention_enabled(struct super_block *sb) {
+
+    return FS_INFO(sb)->opts.ttl != 0 || FS_INFO(sb)->opts.max_msgs != 0;
+}
+
+// elimina un gruppo di messaggi dalla testa della catena del canale e restituisce quanti ne sono stati eliminati
+static int retention_expire_batch(struct super_block *sb, unsigned int chan, int64_t cutoff) {
+
+    int i;
+    int n = 0;
+    int ret;
+    int len;
+    int64_t removed = 0;
+    int expired;
+    uint64_t op_seq;
+    unsigned int curr_block_num;
+    unsigned int blocks[RETENTION_BATCH];
+    struct onefilefs_sb_info *sb_disk;
+    struct bdev_layout *bdev_blk;
+
+    mutex_lock(&(FS_INFO(sb)->chan[chan].lock));
+    mutex_lock(&(FS_INFO(sb)->write_lock));
+
+    sb_disk = get_sb_info(sb);
+    if (sb_disk == NULL) {
+        ret = -EIO;
+        goto retention_exit;
+    }
+
+    // messaggi scaduti (ttl) o in eccesso (max_msgs) a partire dal più vecchio
+    curr_block_num = chan_first_valid(sb_disk, chan);
+    while (n < RETENTION_BATCH && curr_block_num < NBLOCKS-2) {
+        expired = (FS_INFO(sb)->opts.ttl != 0 && FS_INFO(sb)->block_time[curr_block_num] <= cutoff) ||
+                  (FS_INFO(sb)->opts.max_msgs != 0 && FS_INFO(sb)->chan[chan].nr_valid - n > FS_INFO(sb)->opts.max_msgs);
+        if (!expired)
+            break;
+
+        bdev_blk = get_block(sb, blk_offset(curr_block_num));
+        if (bdev_blk == NULL) {
+            ret = -EIO;
+            goto retention_exit;
+        }
+        len = message_len(sb, bdev_blk);
+        if (len < 0) {
+            ret = len;
+            goto retention_exit;
+        }
+        blocks[n++] = curr_block_num;
+        removed += len + 1;
+        if (curr_block_num == chan_last_valid(sb_disk, chan))
+            curr_block_num = -1;
+        else
+            curr_block_num = get_block_num(bdev_blk->next_block);
+    }
+
+    if (n == 0) {
+        ret = 0;
+        goto retention_exit;
+    }
+
+    // il gruppo viene scollegato spostando la testa della catena (un solo record di journal)
+    if (curr_block_num < NBLOCKS-2)
+        ret = set_sb_info(sb, chan, curr_block_num, chan_last_valid(sb_disk, chan));
+    else
+        ret = set_sb_info(sb, chan, -1, -1);
+    if (ret < 0) {
+        ret = -EIO;
+        goto retention_abort;
+    }
+    for (i = 0; i < n; i++)
+        index_remove(sb, FS_INFO(sb)->block_seq[blocks[i]]);
+    FS_INFO(sb)->nr_valid -= n;
+    FS_INFO(sb)->chan[chan].nr_valid -= n;
+    render_bump(sb, chan, 1);
+    chan_size_add(sb, chan, -removed);
+
+    // un solo grace period per l'intero gruppo, atteso senza il write_lock (come in invalidate_data()): lo
+    // scollegamento è un'operazione completa e i blocchi la cui invalidazione fallisce restano validi fino a check_chain()
+    journal_end_op(sb);
+    mutex_unlock(&(FS_INFO(sb)->write_lock));
+    synchronize_srcu(&(FS_INFO(sb)->srcu));
+    mutex_lock(&(FS_INFO(sb)->write_lock));
+
+    for (i = 0; i < n; i++) {
+        if (invalidate_block(sb, blk_offset(blocks[i])) < 0) {
+            ret = -EIO;
+            goto retention_abort;
+        }
+    }
+    op_seq = journal_end_op(sb);
+
+    // un solo commit per l'intero gruppo
+    ret = journal_commit(sb);
+    if (ret < 0)
+        goto retention_exit;
+
+    for (i = 0; i < n; i++)
+        notify_event(sb, NOTIFY_INVALIDATE, blocks[i], op_seq);
+    ret = n;
+    goto retention_exit;
+
+retention_abort:
+    // operazione fallita dopo la registrazione dei primi record: la transazione torna all'ultimo journal_end_op()
+    journal_abort_op(sb);
+retention_exit:
+    mutex_unlock(&(FS_INFO(sb)->write_lock));
+    mutex_unlock(&(FS_INFO(sb)->chan[chan].lock));
+    return ret;
+}
+
+void retention_work(struct work_struct *work) {
+
+    int ret = 0;
+    unsigned int chan;
+    int64_t cutoff;
+    struct filesystem_info *fsi = container_of(to_delayed_work(work), struct filesystem_info, retention_work);
+    struct super_block *sb = fsi->sb;
+
+    cutoff = ktime_get_real_ns() - (int64_t) FS_INFO(sb)->opts.ttl * NSEC_PER_SEC;
+
+    for (chan = 0; ret >= 0 && chan < NCHANNELS; chan++) {
+        do {
+            ret = retention_expire_batch(sb, chan, cutoff);
+            if (ret > 0)
+                LOG printk("%s: [retention] - eliminati %d messaggi dal canale %u\n", MODNAME, ret, chan);
+        } while (ret == RETENTION_BATCH);
+    }
+
+    if (ret < 0)
+        printk(KERN_CRIT "%s: [retention] - eliminazione dei messaggi scaduti fallita (ret=%d)\n", MODNAME, ret);
+
+    schedule_delayed_work(&(FS_INFO(sb)->retention_work), msecs_to_jiffies(RETENTION_INTERVAL_MS));
+}
+
+// avvio del worker di retention al montaggio (solo se ttl= o max_msgs= sono stati specificati)
+void retention_start(struct super_block *sb) {
+
+    if (retention_enabled(sb))
+        schedule_delayed_work(&(FS_INFO(sb)->retention_work), msecs_to_jiffies(RETENTION_INTERVAL_MS));
+}
+
+// arresto del worker di retention allo smontaggio
+void retention_stop(struct super_block *sb) {
+
+    cancel_delayed_work_sync(&(FS_INFO(sb)->retention_work));
+}
@@ -0,0 +1,182 @@
+#include <linux/bitmap.h>
+#include <linux/fs.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include "utils_header.h"
+
+/*
+    Anelli di sottomissione e completamento condivisi con lo spazio utente (uno per file aperto, tipicamente
+    sul device a caratteri): un'unica area vmalloc_user contiene l'intestazione con gli indici, i due anelli
+    e gli slot di RING_SLOT_SIZE byte associati a ciascuna voce, ed è mappata nello spazio utente tramite mmap.
+    IOCTL_RING_ENTER consuma in blocco tutte le voci pubblicate per cui c'è posto nell'anello di completamento:
+    le put vengono eseguite con commit asincrono e, salvo montaggio asincrono, rese persistenti da un'unica
+    attesa prima di pubblicare i completamenti, quindi una sola system call serve un intero batch di messaggi.
+*/
+
+// allocazione degli anelli del file aperto
+int ring_setup(struct onefilefs_file *f, struct ring_setup_args *args) {
+
+    int ret = 0;
+    size_t size;
+    struct blocklevel_ring *ring;
+
+    if (args->entries == 0 || args->entries > RING_MAX_ENTRIES || !is_power_of_2(args->entries))
+        return -EINVAL;
+
+    ring = kzalloc(sizeof(struct blocklevel_ring), GFP_KERNEL);
+    if (!ring)
+        return -ENOMEM;
+
+    // intestazione, voci e slot allineati alla pagina
+    args->sqes_off = PAGE_ALIGN(sizeof(struct ring_header));
+    args->cqes_off = args->sqes_off + PAGE_ALIGN(args->entries * sizeof(struct ring_sqe));
+    args->sq_data_off = args->cqes_off + PAGE_ALIGN(args->entries * sizeof(struct ring_cqe));
+    args->cq_data_off = args->sq_data_off + args->entries * RING_SLOT_SIZE;
+    size = args->cq_data_off + (size_t) args->entries * RING_SLOT_SIZE;
+    args->size = size;
+
+    ring->mem = vmalloc_user(size);
+    ring->put_map = bitmap_zalloc(args->entries, GFP_KERNEL);
+    if (!ring->mem || !ring->put_map) {
+        ring_free(ring);
+        return -ENOMEM;
+    }
+    ring->size = size;
+    ring->mask = args->entries - 1;
+    ring->hdr = ring->mem;
+    ring->sqes = ring->mem + args->sqes_off;
+    ring->cqes = ring->mem + args->cqes_off;
+    ring->sq_data = ring->mem + args->sq_data_off;
+    ring->cq_data = ring->mem + args->cq_data_off;
+    ring->hdr->entries = args->entries;
+    mutex_init(&(ring->lock));
+
+    // un solo setup per file aperto
+    mutex_lock(&(f->cur_lock));
+    if (f->ring == NULL)
+        smp_store_release(&(f->ring), ring);
+    else
+        ret = -EBUSY;
+    mutex_unlock(&(f->cur_lock));
+
+    if (ret < 0)
+        ring_free(ring);
+
+    return ret;
+}
+
+void ring_free(struct blocklevel_ring *ring) {
+
+    if (ring == NULL)
+        return;
+    vfree(ring->mem);
+    bitmap_free(ring->put_map);
+    kfree(ring);
+}
+
+// mappatura degli anelli nello spazio utente (il file resta aperto finché la mappatura esiste): le voci di
+// sottomissione possono contenere put e invalidate, quindi il file deve essere aperto in scrittura
+int ring_mmap(struct blocklevel_ring *ring, struct vm_area_struct *vma) {
+
+    if (!(vma->vm_file->f_mode & FMODE_WRITE))
+        return -EBADF;
+    if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > PAGE_ALIGN(ring->size))
+        return -EINVAL;
+
+    return remap_vmalloc_range(vma, ring->mem, 0);
+}
+
+// consumo delle voci di sottomissione pubblicate (doorbell): restituisce il numero di voci consumate
+int ring_enter(struct super_block *sb, unsigned int chan, struct blocklevel_ring *ring) {
+
+    int ret = 0;
+    int nr_puts = 0;
+    unsigned int n = 0;
+    unsigned int idx;
+    unsigned int sq_head;
+    unsigned int sq_tail;
+    unsigned int cq_head;
+    unsigned int cq_tail;
+    unsigned int cq_start;
+    uint64_t seq;
+    uint64_t put_seq = 0;
+    struct ring_sqe sqe;
+    struct ring_cqe *cqe;
+
+    mutex_lock(&(ring->lock));
+
+    // gli indici scritti dal kernel sono mantenuti anche in ring (quelli condivisi possono essere alterati dall'utente)
+    sq_head = ring->sq_head;
+    sq_tail = smp_load_acquire(&(ring->hdr->sq_tail));
+    cq_head = smp_load_acquire(&(ring->hdr->cq_head));
+    cq_tail = ring->cq_tail;
+    cq_start = cq_tail;
+
+    // ogni voce consumata produce un completamento: ci si ferma quando l'anello di completamento è pieno
+    while (sq_head != sq_tail && cq_tail - cq_head <= ring->mask && n <= ring->mask) {
+        idx = sq_head & ring->mask;
+        memcpy(&sqe, &(ring->sqes[idx]), sizeof(sqe));
+        cqe = &(ring->cqes[cq_tail & ring->mask]);
+        seq = 0;
+
+        switch (sqe.op) {
+            case RING_OP_PUT:
+                cqe->res = put_data_kernel(sb, chan, ring->sq_data + (size_t) idx * RING_SLOT_SIZE, min_t(unsigned int, sqe.len, RING_SLOT_SIZE), 1, &seq);
+                if (cqe->res >= 0) {
+                    nr_puts++;
+                    put_seq = seq;
+                    __set_bit(cq_tail & ring->mask, ring->put_map);
+                }
+                break;
+            case RING_OP_GET:
+                cqe->res = get_data_kernel(sb, sqe.block, ring->cq_data + (size_t) (cq_tail & ring->mask) * RING_SLOT_SIZE, RING_SLOT_SIZE - 1);
+                break;
+            case RING_OP_INVALIDATE:
+                cqe->res = invalidate_data_user(sb, sqe.block, &seq);
+                break;
+            default:
+                cqe->res = -EINVAL;
+                break;
+        }
+        cqe->user_data = sqe.user_data;
+        cqe->seq = seq;
+
+        sq_head++;
+        cq_tail++;
+        n++;
+    }
+
+    // le voci consumate possono essere riutilizzate dal produttore
+    ring->sq_head = sq_head;
+    smp_store_release(&(ring->hdr->sq_head), sq_head);
+
+    // un'unica attesa rende persistenti tutte le put del batch prima di pubblicarne i completamenti
+    if (nr_puts > 0 && READ_ONCE(FS_INFO(sb)->opts.commit_mode) != COMMIT_ASYNC) {
+        atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+        ret = FS_INFO(sb)->mounted ? journal_wait_durable(sb, put_seq) : -ENODEV;
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+    }
+
+    // se l'attesa fallisce le put del batch non sono persistenti: i loro completamenti riportano l'errore
+    for (idx = cq_start; idx != cq_tail; idx++) {
+        if (__test_and_clear_bit(idx & ring->mask, ring->put_map) && ret < 0)
+            ring->cqes[idx & ring->mask].res = ret;
+    }
+
+    ring->cq_tail = cq_tail;
+    smp_store_release(&(ring->hdr->cq_tail), cq_tail);
+
+    mutex_unlock(&(ring->lock));
+
+    LOG printk("%s: [ring_enter()] - consumate %u voci di sottomissione (%d put)\n", MODNAME, n, nr_puts);
+
+    if (ret < 0)
+        return ret;
+    return n;
+}
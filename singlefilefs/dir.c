@@ -10,12 +10,15 @@
 
 #include "../utils_header.h"
 
-// this iterate function just returns 3 entries: . and .. and then the name of the unique file of the file system
+// this iterate function returns . and .. and then the names of the files of the channels (the-file, channel-1, ...)
 static int onefilefs_iterate(struct file *file, struct dir_context* ctx) {
 
+	int len;
+	char name[sizeof(CHANNEL_FILE_PREFIX) + 10];
+
     // printk("%s: we are inside readdir with ctx->pos set to %lld", MODNAME, ctx->pos);
 	
-	if(ctx->pos >= (2 + 1)) return 0;//we cannot return more than . and .. and the unique file entry
+	if(ctx->pos >= (2 + NCHANNELS)) return 0;//we cannot return more than . and .. and the channel file entries
 
 	if (ctx->pos == 0){
     	// printk("%s: we are inside readdir with ctx->pos set to %lld", MODNAME, ctx->pos);
@@ -46,6 +49,15 @@ static int onefilefs_iterate(struct file *file, struct dir_context* ctx) {
 			ctx->pos++;
 		}
 	}
+	while (ctx->pos >= 3 && ctx->pos < 2 + NCHANNELS) {
+		len = snprintf(name, sizeof(name), CHANNEL_FILE_PREFIX "%lld", ctx->pos - 2);
+		if (!dir_emit(ctx, name, len, SINGLEFILEFS_CHANNEL_INODE_NUMBER(ctx->pos - 2), DT_UNKNOWN)) {
+			return 0;
+		}
+		else {
+			ctx->pos++;
+		}
+	}
 
 	return 0;
 }
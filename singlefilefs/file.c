@@ -2,31 +2,60 @@
 #include <linux/fs.h>
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/poll.h>
 #include <linux/slab.h>
+#include <linux/splice.h>
 #include <linux/string.h>
 #include <linux/time.h>
 #include <linux/timekeeping.h>
 #include <linux/types.h>
+#include <linux/uaccess.h>
+#include <linux/uio.h>
 
 #include "../utils_header.h"
 
 int onefilefs_open(struct inode *, struct file *);
 int onefilefs_release(struct inode *, struct file *);
-ssize_t onefilefs_read(struct file *, char *, size_t, loff_t *);
+ssize_t onefilefs_read_iter(struct kiocb *, struct iov_iter *);
+ssize_t onefilefs_splice_read(struct file *, loff_t *, struct pipe_inode_info *, size_t, unsigned int);
+long onefilefs_ioctl(struct file *, unsigned int, unsigned long);
+int onefilefs_fsync(struct file *, loff_t, loff_t, int);
+__poll_t onefilefs_poll(struct file *, poll_table *);
+int onefilefs_mmap(struct file *, struct vm_area_struct *);
+
+// dimensione della pagina di staging in cui la read accumula i messaggi brevi
+#define READ_STAGE_SIZE PAGE_SIZE
+
+// canale associato al nome di un file: the-file è il canale 0, i canali successivi sono esposti come
+// channel-1, ..., channel-(NCHANNELS-1); restituisce -1 se il nome non corrisponde a nessun canale
+static int onefilefs_channel_of(const char *name) {
+
+	unsigned int chan;
+
+	if (!strcmp(name, UNIQUE_FILE_NAME))
+		return 0;
+	if (strncmp(name, CHANNEL_FILE_PREFIX, strlen(CHANNEL_FILE_PREFIX)) ||
+		kstrtouint(name + strlen(CHANNEL_FILE_PREFIX), 10, &chan) || chan == 0 || chan >= NCHANNELS)
+		return -1;
+
+	return chan;
+}
 
 struct dentry *onefilefs_lookup(struct inode *parent_inode, struct dentry *child_dentry, unsigned int flags) {
 
-    struct onefilefs_inode *FS_specific_inode;
     struct super_block *sb = parent_inode->i_sb;
-    struct buffer_head *bh = NULL;
     struct inode *the_inode = NULL;
 
+    int chan;
+
     //printk("%s: running the lookup inode-function for name %s",MODNAME,child_dentry->d_name.name);
 
-    if (!strcmp(child_dentry->d_name.name, UNIQUE_FILE_NAME)) {
+    chan = onefilefs_channel_of(child_dentry->d_name.name);
+    if (chan >= 0) {
 	
 		// get a locked inode from the cache 
-        the_inode = iget_locked(sb, 1);
+        the_inode = iget_locked(sb, SINGLEFILEFS_CHANNEL_INODE_NUMBER(chan));
         if (!the_inode)
        		 return ERR_PTR(-ENOMEM);
 
@@ -37,6 +66,7 @@ struct dentry *onefilefs_lookup(struct inode *parent_inode, struct dentry *child
 
 		// this work is done if the inode was not already cached
 		inode_init_owner(&init_user_ns, the_inode, NULL, S_IFREG );
+		the_inode->i_private = (void *)(unsigned long) chan;
 		the_inode->i_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH | S_IWUSR | S_IWGRP | S_IXUSR | S_IXGRP | S_IXOTH;
 
 		the_inode->i_fop = &onefilefs_file_operations;
@@ -45,16 +75,11 @@ struct dentry *onefilefs_lookup(struct inode *parent_inode, struct dentry *child
 		// just one link for this file
 		set_nlink(the_inode,1);
 
-		// now we retrieve the file size via the FS specific inode, putting it into the generic inode
-		bh = (struct buffer_head *)sb_bread(sb, SINGLEFILEFS_INODES_BLOCK_NUMBER );
-		if (!bh) {
-			iput(the_inode);
-			return ERR_PTR(-EIO);
-		}
-
-		FS_specific_inode = (struct onefilefs_inode*)bh->b_data;
-		the_inode->i_size = FS_specific_inode->file_size;
-		brelse(bh);
+		// dimensione e istante di modifica del contenuto del canale (il file_size dell'inode sul device non
+		// corrisponde al contenuto restituito dalla read); le modifiche successive vengono riportate sull'inode da
+		// chan_size_add(), che attende lo sblocco dell'inode nuovo
+		the_inode->i_size = READ_ONCE(FS_INFO(sb)->chan[chan].size);
+		the_inode->i_mtime = the_inode->i_ctime = the_inode->i_atime = FS_INFO(sb)->chan[chan].mtime;
 
 		d_add(child_dentry, the_inode);
 		dget(child_dentry);
@@ -71,145 +96,1098 @@ struct dentry *onefilefs_lookup(struct inode *parent_inode, struct dentry *child
 // Open operation
 int onefilefs_open(struct inode *inode, struct file *file) {
 	
+	int ret;
+	struct onefilefs_file *f;
+	struct super_block *sb = inode->i_sb;
+
+	// i file del file system operano sul proprio montaggio, il device a caratteri sul montaggio predefinito
+	// (mantenuto attivo fino alla chiusura del file)
+	if (sb->s_magic != MAGIC) {
+		sb = singlefilefs_get_default();
+		if (sb == NULL)
+			return -ENODEV;
+	}
+
 	// controlla se il filesystem è montato
-	if(!fs_info.mounted){
-		printk("%s: [onefilefs_open()] - il file system non è montato\n", MODNAME);
-        return -ENODEV;
+	if(!FS_INFO(sb)->mounted){
+		LOG printk("%s: [onefilefs_open()] - il file system non è montato\n", MODNAME);
+		ret = -ENODEV;
+		goto open_error;
 	}
 
-	// nega aperture del file in scrittura (filesystem in sola lettura)
-	if (file->f_mode & FMODE_WRITE) {
-		printk("%s: [onefilefs_open()] - apertura in modalità scrittura non consentita\n", MODNAME);
-		return -EROFS;
+	// l'apertura in scrittura non abilita la write (non supportata, il contenuto si modifica solo tramite system
+	// call e ioctl) ma è richiesta dalle ioctl che modificano il device e dalla mappatura degli anelli di sottomissione
+
+	// posizione del lettore all'interno della sequenza dei messaggi
+	f = kzalloc(sizeof(struct onefilefs_file), GFP_KERNEL);
+	if (!f) {
+		printk(KERN_CRIT "%s: [onefilefs_open()] - errore kzalloc, impossibile allocare memoria\n", MODNAME);
+		ret = -ENOMEM;
+		goto open_error;
 	}
+	mutex_init(&(f->cur_lock));
+	mutex_init(&(f->read_lock));
+	f->cur_block = -1;
+	f->chan = (unsigned long) inode->i_private;
+	f->sb = sb;
+	file->private_data = f;
+
+	// la posizione del lettore è un messaggio della sequenza e non un offset in byte: il file è uno stream, quindi
+	// lseek e pread falliscono con -ESPIPE invece di leggere dalla posizione del lettore ignorando l'offset
+	stream_open(inode, file);
 
-	printk("%s: [onefilefs_open()] - device correttamente aperto\n", MODNAME);
+	LOG printk("%s: [onefilefs_open()] - device correttamente aperto\n", MODNAME);
+
+	return 0;
+
+open_error:
+	if (sb != inode->i_sb)
+		deactivate_super(sb);
+	return ret;
+}
+
+// controlla se sono stati collegati messaggi successivi all'ultimo consegnato al lettore
+static int onefilefs_has_data(struct onefilefs_file *f) {
+
+	return smp_load_acquire(&(FS_INFO(f->sb)->chan[f->chan].msg_seq)) > f->seq;
+}
+
+// consegna all'iteratore i messaggi accumulati nella pagina di staging del file
+static int onefilefs_stage_flush(struct onefilefs_file *f, struct iov_iter *to, size_t *staged) {
+
+	if (*staged > 0 && copy_to_iter(f->stage, *staged, to) != *staged)
+		return -EFAULT;
+	*staged = 0;
 
 	return 0;
 }
 
-// Read operation
-ssize_t onefilefs_read(struct file *file, char __user *buf, size_t count, loff_t *pos) {
+// attende in follow mode che venga collegato un messaggio non ancora consegnato al lettore (utilizzo del file system
+// acquisito): restituisce 1 se ci sono messaggi da consegnare, 0 alla fine del file oppure un errore
+static int onefilefs_wait_data(struct onefilefs_file *f, int nonblock) {
 
 	int ret;
+	struct super_block *sb = f->sb;
+
+	while (!onefilefs_has_data(f)) {
+		if (!f->follow)
+			return 0;
+		if (nonblock)
+			return -EAGAIN;
+
+		// l'attesa non conta come utilizzo del file system
+		atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+		ret = wait_event_interruptible(FS_INFO(sb)->chan[f->chan].read_wq, onefilefs_has_data(f) || !READ_ONCE(f->follow) || !FS_INFO(sb)->mounted);
+		atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+		if (ret != 0)
+			return ret;
+		if (!FS_INFO(sb)->mounted)
+			return -ENODEV;
+	}
+
+	return 1;
+}
+
+// Read operation - restituisce i messaggi validi (uno per riga) a partire dalla posizione del lettore; la
+// destinazione è un iteratore, quindi la stessa funzione serve read() e readv() (splice()/sendfile() sono servite
+// senza copie da onefilefs_splice_read())
+ssize_t onefilefs_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+
+	int ret = 0;
+	size_t copied = 0;
+	size_t todo;
+	size_t data_len;
+	size_t staged;
+	size_t room;
+	ssize_t rendered;
 	int length;
-	int copied;
+	unsigned int off;
 	int srcu_idx;
+	uint64_t seq;
+	uint64_t last_seq;
+	uint64_t done_seq = 0;
+	uint64_t done_partial_seq = 0;
+	unsigned int done_partial_off = 0;
 
-	char *klvl_buf;
 	char newline_str = '\n';
-	char end_str = '\0';
 
 	unsigned int curr_block_num;
 
+	struct file *file = iocb->ki_filp;
+	size_t count = iov_iter_count(to);
+	struct onefilefs_file *f = file->private_data;
+	struct super_block *sb = f->sb;
 	struct onefilefs_sb_info *sb_disk;
 	struct bdev_layout *bdev_blk;
 	
-	if (*pos != 0) return 0;
-	copied = 0;
+	if (count == 0) return 0;
 
-	printk("%s: [onefilefs_read()] - operazione read invocata\n", MODNAME);
+	LOG printk("%s: [onefilefs_read_iter()] - operazione read invocata\n", MODNAME);
 
 	// incremento del contatore atomico degli utilizzi del file system
-    atomic_fetch_add(1, &(fs_info.usage));
+    atomic_fetch_add(1, &(FS_INFO(sb)->usage));
 
 	// sanity checks
-    if (!fs_info.mounted) { // controlla se il file system è montato
-        printk(KERN_INFO "%s: [onefilefs_read()] - il file system non è montato\n", MODNAME);
-        atomic_fetch_add(-1, &(fs_info.usage));
+    if (!FS_INFO(sb)->mounted) { // controlla se il file system è montato
+        LOG printk(KERN_INFO "%s: [onefilefs_read_iter()] - il file system non è montato\n", MODNAME);
+        atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
         return -ENODEV;
     }  
 
+read_again:
+	// fine del file: EOF, oppure in follow mode attesa di un nuovo messaggio
+	ret = onefilefs_wait_data(f, (file->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT));
+	if (ret <= 0)
+		goto read_exit;
+	ret = 0;
+	mutex_lock(&(f->read_lock));
+	last_seq = smp_load_acquire(&(FS_INFO(sb)->chan[f->chan].msg_seq));
+
+	// lettura servita dalla copia renderizzata del canale, se disponibile
+	rendered = render_read(sb, f, to, last_seq);
+	if (rendered != -ENODATA) {
+		if (rendered > 0)
+			copied = rendered;
+		else
+			ret = rendered;
+		goto read_unlock;
+	}
+
+	// altrimenti la catena dei blocchi viene scorsa, con i messaggi brevi accumulati nella pagina di staging
+	// (se non disabilitata con read_stage=0)
+	if (FS_INFO(sb)->opts.read_stage && f->stage == NULL) {
+		f->stage = (char *) __get_free_page(GFP_KERNEL);
+		if (f->stage == NULL) {
+			printk(KERN_CRIT "%s: [onefilefs_read_iter()] - errore __get_free_page, impossibile allocare memoria\n", MODNAME);
+			mutex_unlock(&(f->read_lock));
+			ret = -ENOMEM;
+			goto read_exit;
+		}
+	}
+
 	// acquisizione della sleepable RCU read lock
-    srcu_idx = srcu_read_lock(&(fs_info.srcu));
+    srcu_idx = srcu_read_lock(&(FS_INFO(sb)->srcu));
 
 	// recupero dei dati memorizzati nel superblocco
-    sb_disk = get_sb_info(global_sb);
+    sb_disk = get_sb_info(sb);
     if (sb_disk == NULL) {
-        printk(KERN_CRIT "%s: [onefilefs_read()] - errore durante il recupero del superblocco\n", MODNAME);
-        srcu_read_unlock(&(fs_info.srcu), srcu_idx);
+        printk(KERN_CRIT "%s: [onefilefs_read_iter()] - errore durante il recupero del superblocco\n", MODNAME);
+        srcu_read_unlock(&(FS_INFO(sb)->srcu), srcu_idx);
+		mutex_unlock(&(f->read_lock));
         ret = -EIO;
         goto read_exit;
     }
-	
-	// controllo se attualmente ci sono blocchi validi
-	if (sb_disk->first_valid == -1) {
-		printk(KERN_INFO "%s: [onefilefs_read()] - nessun blocco valido\n", MODNAME);
-        srcu_read_unlock(&(fs_info.srcu), srcu_idx);
-		ret = 0;
-		goto read_exit;
-	}
-	curr_block_num = sb_disk->first_valid;
+	curr_block_num = chan_first_valid(sb_disk, f->chan);
+
+	staged = 0;
 
-	// leggo in ordine tutti i blocchi validi e restituisco il contenuto nel buffer utente
-	while (curr_block_num != get_block_num(set_valid(-1))) {
+	// scorro in ordine i blocchi validi e consegno quelli successivi all'ultimo messaggio letto
+	while (curr_block_num < NBLOCKS-2 && copied < count) {
 
 		// recupero del blocco da leggere
-		bdev_blk = get_block(global_sb, blk_offset(curr_block_num));
+		bdev_blk = get_block(sb, blk_offset(curr_block_num));
 		if (bdev_blk == NULL) {
-			printk(KERN_CRIT "%s: [onefilefs_read()] - errore durante il recupero del blocco %d\n", MODNAME, curr_block_num);
-			srcu_read_unlock(&(fs_info.srcu), srcu_idx);
+			printk(KERN_CRIT "%s: [onefilefs_read_iter()] - errore durante il recupero del blocco %d\n", MODNAME, curr_block_num);
 			ret = -EIO;
-			goto read_exit;
+			break;
 		}
 
-		length = strlen(bdev_blk->data);
-		printk(KERN_INFO "%s: [onefilefs_read()] - blocco %u, %s, len=%d\n", MODNAME, curr_block_num, bdev_blk->data, length);
+		seq = READ_ONCE(FS_INFO(sb)->block_seq[curr_block_num]);
+		if (seq > f->seq && seq <= last_seq) {
+			off = (f->partial_seq == seq) ? f->partial_off : 0;
+			room = READ_STAGE_SIZE - staged;
+			length = block_data_len(bdev_blk);
+			if (length < 0) {
+				ret = length;
+				break;
+			}
+			data_len = length;
 
-		klvl_buf = kmalloc(length + 1, GFP_KERNEL);
-		if (!klvl_buf) {
-			printk(KERN_CRIT "%s: [onefilefs_read()] - errore kmalloc, impossibile allocare memoria\n", MODNAME);
-			srcu_read_unlock(&(fs_info.srcu), srcu_idx);
-			ret = -1;
-			goto read_exit;
+			// i messaggi brevi (senza blocchi di continuazione) vengono accumulati insieme al fine riga nella pagina
+			// di staging e consegnati con un'unica copia verso l'utente per pagina; gli altri svuotano la pagina e
+			// vengono copiati direttamente
+			if (FS_INFO(sb)->opts.read_stage && !get_validity(READ_ONCE(bdev_blk->cont_block)) && off <= data_len && data_len - off < room) {
+				// posizione del lettore da ripristinare se la copia della pagina verso l'utente fallisce
+				if (staged == 0) {
+					done_seq = f->seq;
+					done_partial_seq = f->partial_seq;
+					done_partial_off = f->partial_off;
+				}
+				length = copy_message_to_kernel(sb, curr_block_num, bdev_blk, f->stage + staged, off, min(room, count - copied), &data_len);
+				if (length < 0) {
+					ret = length;
+					break;
+				}
+				if (off > length)
+					off = length;
+				todo = data_len;
+				if (off + data_len == length && data_len < room && copied + data_len < count)
+					f->stage[staged + todo++] = '\n';
+				staged += todo;
+			}
+			else {
+				ret = onefilefs_stage_flush(f, to, &staged);
+				if (ret != 0)
+					break;
+
+				// porzione ancora da consegnare del messaggio (letta per intero prima o dopo un eventuale
+				// aggiornamento in-place) seguito dal carattere di fine riga
+				length = copy_message_to_iter(sb, curr_block_num, bdev_blk, to, off, count - copied, &data_len);
+				if (length < 0) {
+					ret = length;
+					break;
+				}
+
+				// il messaggio può essersi accorciato dopo una lettura parziale
+				if (off > length)
+					off = length;
+				todo = data_len;
+				if (off + data_len == length && copied + data_len < count) {
+					if (copy_to_iter(&newline_str, 1, to) != 1) {
+						ret = -EFAULT;
+						break;
+					}
+					todo++;
+				}
+			}
+			AUDIT printk(KERN_INFO "%s: [onefilefs_read_iter()] - blocco %u, seq %llu, len=%d\n", MODNAME, curr_block_num, seq, length);
+
+			copied += todo;
+			off += todo;
+
+			if (off == length + 1) {
+				f->seq = seq;
+				f->partial_seq = 0;
+				f->partial_off = 0;
+			}
+			else {
+				f->partial_seq = seq;
+				f->partial_off = off;
+
+				// messaggio cresciuto dopo il controllo e non entrato per intero nella pagina di staging: la pagina
+				// viene consegnata e il messaggio ripreso dallo stesso blocco
+				if (staged > 0 && copied < count) {
+					ret = onefilefs_stage_flush(f, to, &staged);
+					if (ret != 0)
+						break;
+					continue;
+				}
+			}
 		}
 
-		memcpy(klvl_buf, bdev_blk->data, length);
-		klvl_buf[length] = newline_str;
-		ret = copy_to_user(buf + copied, klvl_buf, length + 1);
-		copied = copied + length + 1 - ret; 
-		printk(KERN_INFO "%s: [onefilefs_read()] - copiati %d bytes\n", MODNAME, copied);
-		kfree(klvl_buf);
 		curr_block_num = get_block_num(bdev_blk->next_block);
 	}
 	
 	// rilascio della sleepable RCU read lock
-    srcu_read_unlock(&(fs_info.srcu), srcu_idx);
+    srcu_read_unlock(&(FS_INFO(sb)->srcu), srcu_idx);
+
+	// consegna dei messaggi rimasti nella pagina di staging; in caso di errore il lettore torna all'ultimo byte
+	// effettivamente copiato
+	if (onefilefs_stage_flush(f, to, &staged) != 0) {
+		ret = -EFAULT;
+		copied -= staged;
+		f->seq = done_seq;
+		f->partial_seq = done_partial_seq;
+		f->partial_off = done_partial_off;
+	}
 
-	ret = copy_to_user(buf + copied, &end_str, 1);
-	copied = copied + 1 - ret;
-	ret = count;
+read_unlock:
+	// i messaggi più recenti sono già stati invalidati: nulla da consegnare fino a last_seq
+	if (ret == 0 && copied == 0) {
+		f->seq = last_seq;
+		mutex_unlock(&(f->read_lock));
+		goto read_again;
+	}
+	mutex_unlock(&(f->read_lock));
 
 read_exit:
-	atomic_fetch_add(-1, &(fs_info.usage));
+	atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+
+	iocb->ki_pos += copied;
+
+	LOG printk("%s: [onefilefs_read_iter()] - read avvenuta con successo (copiati %zu bytes)\n", MODNAME, copied);
+
+	// i byte già consegnati hanno la precedenza su un eventuale errore successivo
+	if (copied > 0)
+		return copied;
+	return ret;
+}
+
+// conferma di un buffer della pipe che referenzia la pagina di un blocco, prima che il contenuto venga consumato:
+// fallisce se il blocco non contiene più il messaggio consegnato (private), cioè è stato riutilizzato dopo
+// un'invalidazione
+static int onefilefs_pipe_buf_confirm(struct pipe_inode_info *pipe, struct pipe_buffer *buf) {
+
+	struct bdev_layout *bdev_blk;
 
-	*pos = *pos + copied;
+	// il buffer con il fine riga non referenzia un blocco
+	if (buf->private == 0)
+		return 0;
 
-	printk("%s: [onefilefs_read()] - read avvenuta con successo\n", MODNAME);
+	bdev_blk = (struct bdev_layout *) (page_address(buf->page) + round_down(buf->offset, DEFAULT_BLOCK_SIZE));
+	if (READ_ONCE(bdev_blk->seq) != buf->private)
+		return -ENODATA;
 
+	return 0;
+}
+
+static const struct pipe_buf_operations onefilefs_pipe_buf_ops = {
+	.confirm = onefilefs_pipe_buf_confirm,
+	.release = generic_pipe_buf_release,
+	.get = generic_pipe_buf_get,
+};
+
+static void onefilefs_spd_release(struct splice_pipe_desc *spd, unsigned int i) {
+
+	put_page(spd->pages[i]);
+}
+
+// Splice operation - consegna i messaggi alla pipe senza copie: ogni porzione di messaggio (primo blocco e blocchi
+// di continuazione) è un buffer della pipe che referenzia la pagina del blocco nella page cache del device, seguito
+// da un buffer con il fine riga; la posizione del lettore avanza solo per i buffer effettivamente inseriti nella
+// pipe (un aggiornamento in-place successivo è visibile a chi consuma la pipe, un riutilizzo del blocco no)
+ssize_t onefilefs_splice_read(struct file *in, loff_t *ppos, struct pipe_inode_info *pipe, size_t len, unsigned int flags) {
+
+	ssize_t ret = 0;
+	size_t total;
+	size_t n;
+	unsigned int slots;
+	unsigned int off;
+	unsigned int pos;
+	int blk_len;
+	unsigned int cont;
+	unsigned int hops;
+	unsigned int cont_hops;
+	unsigned int i;
+	unsigned int curr_block_num;
+	int srcu_idx;
+	uint64_t seq;
+	uint64_t last_seq;
+	uint64_t piece_seq[PIPE_DEF_BUFFERS];      // messaggio di ciascun buffer
+	unsigned int piece_off[PIPE_DEF_BUFFERS];  // posizione nel messaggio dopo ciascun buffer
+	struct page *pages[PIPE_DEF_BUFFERS];
+	struct partial_page partial[PIPE_DEF_BUFFERS];
+	struct splice_pipe_desc spd = {
+		.pages = pages,
+		.partial = partial,
+		.nr_pages_max = PIPE_DEF_BUFFERS,
+		.ops = &onefilefs_pipe_buf_ops,
+		.spd_release = onefilefs_spd_release,
+	};
+	struct page *nl_page = NULL;
+	struct onefilefs_file *f = in->private_data;
+	struct super_block *sb = f->sb;
+	struct onefilefs_sb_info *sb_disk;
+	struct bdev_layout *bdev_blk;
+	struct bdev_layout *cont_blk;
+
+	if (len == 0)
+		return 0;
+
+	LOG printk("%s: [onefilefs_splice_read()] - operazione splice invocata\n", MODNAME);
+
+	// incremento del contatore atomico degli utilizzi del file system
+	atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+	if (!FS_INFO(sb)->mounted) {
+		ret = -ENODEV;
+		goto splice_exit;
+	}
+
+	// pagina con il fine riga, condivisa dai buffer che chiudono i messaggi
+	nl_page = alloc_page(GFP_KERNEL);
+	if (!nl_page) {
+		ret = -ENOMEM;
+		goto splice_exit;
+	}
+	*((char *) page_address(nl_page)) = '\n';
+
+splice_again:
+	// fine del file: EOF, oppure in follow mode attesa di un nuovo messaggio
+	ret = onefilefs_wait_data(f, (in->f_flags & O_NONBLOCK) || (flags & SPLICE_F_NONBLOCK));
+	if (ret <= 0)
+		goto splice_exit;
+	ret = 0;
+
+	// buffer liberi nella pipe (bloccata dal chiamante)
+	slots = min_t(unsigned int, PIPE_DEF_BUFFERS, pipe->max_usage - pipe_occupancy(pipe->head, pipe->tail));
+	if (slots == 0) {
+		ret = -EAGAIN;
+		goto splice_exit;
+	}
+
+	mutex_lock(&(f->read_lock));
+	last_seq = smp_load_acquire(&(FS_INFO(sb)->chan[f->chan].msg_seq));
+	spd.nr_pages = 0;
+	total = 0;
+	hops = 0;
+	curr_block_num = NBLOCKS-2;
+
+	srcu_idx = srcu_read_lock(&(FS_INFO(sb)->srcu));
+
+	sb_disk = get_sb_info(sb);
+	if (sb_disk == NULL)
+		ret = -EIO;
+	else
+		curr_block_num = chan_first_valid(sb_disk, f->chan);
+
+	// scorro in ordine i blocchi validi e referenzio quelli successivi all'ultimo messaggio consegnato
+	while (curr_block_num < NBLOCKS-2 && spd.nr_pages < slots && total < len && hops++ < NBLOCKS-2) {
+		bdev_blk = get_block(sb, blk_offset(curr_block_num));
+		if (bdev_blk == NULL) {
+			ret = -EIO;
+			break;
+		}
+
+		seq = READ_ONCE(FS_INFO(sb)->block_seq[curr_block_num]);
+		if (seq > f->seq && seq <= last_seq) {
+			off = (f->partial_seq == seq) ? f->partial_off : 0;
+
+			// porzioni dei blocchi del messaggio successive alla posizione del lettore
+			pos = 0;
+			cont_blk = bdev_blk;
+			cont_hops = 0;
+			while (cont_blk != NULL) {
+				blk_len = block_data_len(cont_blk);
+				if (blk_len < 0) {
+					ret = blk_len;
+					break;
+				}
+				if (off < pos + blk_len && spd.nr_pages < slots && total < len) {
+					n = min_t(size_t, pos + blk_len - off, len - total);
+					pages[spd.nr_pages] = virt_to_page(cont_blk);
+					get_page(pages[spd.nr_pages]);
+					partial[spd.nr_pages].offset = offset_in_page(cont_blk->data) + off - pos;
+					partial[spd.nr_pages].len = n;
+					partial[spd.nr_pages].private = seq;
+					off += n;
+					total += n;
+					piece_seq[spd.nr_pages] = seq;
+					piece_off[spd.nr_pages++] = off;
+				}
+				pos += blk_len;
+
+				cont = READ_ONCE(cont_blk->cont_block);
+				if (!get_validity(cont) || get_block_num(cont) >= NBLOCKS-2 || cont_hops++ >= NBLOCKS-2)
+					break;
+				cont_blk = get_block(sb, blk_offset(get_block_num(cont)));
+				if (cont_blk == NULL)
+					ret = -EIO;
+			}
+			if (ret < 0)
+				break;
+
+			// fine riga dopo l'ultimo byte del messaggio (che può essersi accorciato dopo una lettura parziale)
+			if (off > pos)
+				off = pos;
+			if (off == pos && spd.nr_pages < slots && total < len) {
+				pages[spd.nr_pages] = nl_page;
+				get_page(nl_page);
+				partial[spd.nr_pages].offset = 0;
+				partial[spd.nr_pages].len = 1;
+				partial[spd.nr_pages].private = 0;
+				off++;
+				total++;
+				piece_seq[spd.nr_pages] = seq;
+				piece_off[spd.nr_pages++] = off;
+			}
+
+			// messaggio non consegnato per intero: la pipe o la richiesta sono piene
+			if (off != pos + 1)
+				break;
+		}
+
+		curr_block_num = get_block_num(bdev_blk->next_block);
+	}
+
+	srcu_read_unlock(&(FS_INFO(sb)->srcu), srcu_idx);
+
+	// i messaggi più recenti sono già stati invalidati: nulla da consegnare fino a last_seq
+	if (ret == 0 && spd.nr_pages == 0) {
+		f->seq = last_seq;
+		mutex_unlock(&(f->read_lock));
+		goto splice_again;
+	}
+
+	// i buffer già referenziati hanno la precedenza su un eventuale errore successivo; quelli che non entrano
+	// nella pipe vengono rilasciati da splice_to_pipe()
+	if (spd.nr_pages > 0)
+		ret = splice_to_pipe(pipe, &spd);
+
+	// posizione del lettore: ultimo buffer inserito per intero nella pipe
+	for (i = 0, n = 0; ret > 0 && i < spd.nr_pages && n + partial[i].len <= (size_t) ret; n += partial[i].len, i++) {
+		if (partial[i].private == 0) {
+			f->seq = piece_seq[i];
+			f->partial_seq = 0;
+			f->partial_off = 0;
+		}
+		else {
+			f->partial_seq = piece_seq[i];
+			f->partial_off = piece_off[i];
+		}
+	}
+	mutex_unlock(&(f->read_lock));
+
+	if (ret > 0 && ppos)
+		*ppos += ret;
+
+	LOG printk("%s: [onefilefs_splice_read()] - splice terminata (ret=%zd)\n", MODNAME, ret);
+
+splice_exit:
+	if (nl_page)
+		put_page(nl_page);
+	atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
 	return ret;
 }
 
+// Poll operation - the-file è leggibile quando sono stati collegati nuovi messaggi
+__poll_t onefilefs_poll(struct file *file, poll_table *wait) {
+
+	struct onefilefs_file *f = file->private_data;
+
+	poll_wait(file, &(FS_INFO(f->sb)->chan[f->chan].read_wq), wait);
+
+	if (!FS_INFO(f->sb)->mounted)
+		return EPOLLERR;
+	if (onefilefs_has_data(f))
+		return EPOLLIN | EPOLLRDNORM;
+
+	return 0;
+}
+
 // Close operation
 int onefilefs_release(struct inode *inode, struct file *file) {
 	
+	int ret = 0;
+	struct onefilefs_file *f = file->private_data;
+	struct super_block *sb = f->sb;
+
+	ring_free(f->ring);
+	free_page((unsigned long) f->stage);
+	kfree(f);
+
 	// controlla se il filesystem è montato
-	if(!fs_info.mounted){
-		printk("%s: [onefilefs_release()] - il file system non è montato\n", MODNAME);
-        return -ENODEV;
+	if(!FS_INFO(sb)->mounted){
+		LOG printk("%s: [onefilefs_release()] - il file system non è montato\n", MODNAME);
+		ret = -ENODEV;
+	}
+	else {
+		LOG printk("%s: [onefilefs_release()] - device correttamente rilasciato\n", MODNAME);
+	}
+
+	// rilascio del montaggio predefinito acquisito all'apertura tramite il device a caratteri
+	if (sb != inode->i_sb)
+		deactivate_super(sb);
+
+	return ret;
+}
+
+// Fsync operation - rende persistenti tutte le operazioni eseguite fino a questo momento
+int onefilefs_fsync(struct file *file, loff_t start, loff_t end, int datasync) {
+
+	int ret;
+	struct onefilefs_file *f = file->private_data;
+	struct super_block *sb = f->sb;
+
+	atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+
+	if (!FS_INFO(sb)->mounted) {
+		LOG printk(KERN_INFO "%s: [onefilefs_fsync()] - il file system non è montato\n", MODNAME);
+		atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+		return -ENODEV;
+	}
+
+	// commit del journal: blocchi dati scritti e attesi prima del blocco di commit, scritto con REQ_PREFLUSH | REQ_FUA
+	mutex_lock(&(FS_INFO(sb)->write_lock));
+	ret = journal_sync(sb);
+	mutex_unlock(&(FS_INFO(sb)->write_lock));
+
+	atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+
+	LOG printk("%s: [onefilefs_fsync()] - fsync completata (ret=%d)\n", MODNAME, ret);
+
+	return ret;
+}
+
+// posiziona il cursore del file aperto in testa, in coda oppure dopo un numero di sequenza
+static int onefilefs_cursor_open(struct onefilefs_file *f, struct cursor_args *args) {
+
+	switch (args->whence) {
+		case CURSOR_HEAD:
+			f->cur_seq = 0;
+			break;
+		case CURSOR_TAIL:
+			f->cur_seq = smp_load_acquire(&(FS_INFO(f->sb)->chan[f->chan].msg_seq));
+			break;
+		case CURSOR_SEQ:
+			f->cur_seq = args->seq;
+			break;
+		default:
+			return -EINVAL;
+	}
+	f->cur_block = -1;
+
+	return 0;
+}
+
+// copia in buf al più max messaggi successivi alla posizione (cur_seq, cur_block) nell'ordine della catena,
+// avanzando la posizione: la ripresa parte dal blocco dell'ultimo messaggio restituito se è ancora valido,
+// altrimenti dall'indice sequenza -> blocco
+static int onefilefs_fetch(struct super_block *sb, unsigned int chan, uint64_t *cur_seq, unsigned int *cur_block, char __user *buf, size_t size, unsigned int max, unsigned int *count) {
+
+	int ret = 0;
+	int srcu_idx;
+	int relookup = 0;
+	size_t used = 0;
+	size_t need;
+	size_t copied;
+	unsigned int n = 0;
+	unsigned int length;
+	unsigned int block = -1;
+	uint64_t seq;
+	uint64_t last_seq;
+	struct cursor_msg msg;
+	struct bdev_layout *bdev_blk;
+
+	last_seq = smp_load_acquire(&(FS_INFO(sb)->chan[chan].msg_seq));
+
+	// acquisizione della sleepable RCU read lock
+	srcu_idx = srcu_read_lock(&(FS_INFO(sb)->srcu));
+
+	if (*cur_block < NBLOCKS-2 && READ_ONCE(FS_INFO(sb)->block_seq[*cur_block]) == *cur_seq) {
+		bdev_blk = get_block(sb, blk_offset(*cur_block));
+		if (bdev_blk != NULL && block_is_message(bdev_blk))
+			block = get_block_num(bdev_blk->next_block);
+		else
+			block = index_next(sb, *cur_seq, last_seq, chan);
+	}
+	else {
+		block = index_next(sb, *cur_seq, last_seq, chan);
+	}
+
+	while (n < max && block < NBLOCKS-2) {
+
+		bdev_blk = get_block(sb, blk_offset(block));
+		if (bdev_blk == NULL) {
+			printk(KERN_CRIT "%s: [onefilefs_ioctl()] - errore durante il recupero del blocco %d\n", MODNAME, block);
+			ret = -EIO;
+			break;
+		}
+		seq = READ_ONCE(FS_INFO(sb)->block_seq[block]);
+
+		// catena modificata durante la visita: riposizionamento (una sola volta) tramite l'indice
+		if (!block_is_message(bdev_blk) || seq <= *cur_seq) {
+			if (relookup)
+				break;
+			relookup = 1;
+			block = index_next(sb, *cur_seq, last_seq, chan);
+			continue;
+		}
+		relookup = 0;
+		if (seq > last_seq)
+			break;
+
+		// i dati vengono copiati prima dell'intestazione, così la lunghezza riportata è quella della versione
+		// del messaggio effettivamente consegnata (anche in presenza di aggiornamenti in-place concorrenti)
+		length = (size > used + sizeof(msg)) ? min_t(size_t, size - used - sizeof(msg), INT_MAX) : 0;
+		ret = copy_message_to_user(sb, block, bdev_blk, buf + used + sizeof(msg), 0, length, &copied);
+		if (ret < 0)
+			break;
+		length = ret;
+		ret = 0;
+		need = CURSOR_MSG_SIZE(length);
+		if (used + need > size) {
+			if (n == 0)
+				ret = -EOVERFLOW;
+			break;
+		}
+
+		msg.seq = seq;
+		msg.timestamp = bdev_blk->timestamp;
+		msg.block = block;
+		msg.len = length;
+		if (copy_to_user(buf + used, &msg, sizeof(msg))) {
+			ret = -EFAULT;
+			break;
+		}
+		used += need;
+		n++;
+
+		*cur_seq = seq;
+		*cur_block = block;
+		block = get_block_num(bdev_blk->next_block);
+	}
+
+	// rilascio della sleepable RCU read lock
+	srcu_read_unlock(&(FS_INFO(sb)->srcu), srcu_idx);
+
+	*count = n;
+
+	// i messaggi già consegnati hanno la precedenza su un eventuale errore successivo
+	if (n > 0)
+		return 0;
+	return ret;
+}
+
+// messaggi con sequenza o istante di inserimento maggiore di args->value, individuati tramite l'indice in memoria
+static int onefilefs_query_since(struct super_block *sb, unsigned int chan, struct query_args *args) {
+
+	int ret;
+	uint64_t seq;
+	unsigned int block = -1;
+
+	switch (args->by) {
+		case QUERY_SEQ:
+			if (args->value < 0)
+				return -EINVAL;
+			seq = args->value;
+			break;
+		case QUERY_TIME:
+			seq = index_seq_before_time(sb, args->value, smp_load_acquire(&(FS_INFO(sb)->msg_seq)));
+			break;
+		default:
+			return -EINVAL;
+	}
+
+	ret = onefilefs_fetch(sb, chan, &seq, &block, args->buf, args->size, args->max, &(args->count));
+	args->seq = seq;
+
+	return ret;
+}
+
+// put_data() di un batch di messaggi sul canale del file: le put vengono eseguite in ordine con commit asincrono
+// e, salvo montaggio asincrono, rese persistenti da un unico commit finale
+static int onefilefs_put_batch(struct super_block *sb, unsigned int chan, struct batch_args *args) {
+
+	int ret = 0;
+	uint64_t seq = 0;
+	struct put_batch_entry entry;
+	struct put_batch_entry __user *entries = (struct put_batch_entry __user *) args->entries;
+
+	if (args->nr > BATCH_MAX)
+		return -EINVAL;
+
+	for (args->done = 0; args->done < args->nr; args->done++) {
+		if (copy_from_user(&entry, &(entries[args->done]), sizeof(entry))) {
+			ret = -EFAULT;
+			break;
+		}
+		entry.block = put_data_user(sb, chan, entry.source, entry.size, 1, &seq);
+		if (put_user(entry.block, &(entries[args->done].block))) {
+			ret = -EFAULT;
+			break;
+		}
+		if (entry.block < 0) {
+			ret = entry.block;
+			break;
+		}
+	}
+	args->seq = seq;
+
+	if (args->done > 0 && READ_ONCE(FS_INFO(sb)->opts.commit_mode) != COMMIT_ASYNC) {
+		atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+		ret = FS_INFO(sb)->mounted ? journal_wait_durable(sb, seq) : -ENODEV;
+		atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+		return ret;
 	}
 
-	printk("%s: [onefilefs_release()] - device correttamente rilasciato\n", MODNAME);
+	// le put già eseguite hanno la precedenza sull'errore della voce che ha interrotto il batch
+	if (args->done > 0)
+		return 0;
+	return ret;
+}
+
+// get_data() di un batch di blocchi: l'esito di ogni lettura viene riportato nella relativa voce
+static int onefilefs_get_batch(struct super_block *sb, struct batch_args *args) {
+
+	struct get_batch_entry entry;
+	struct get_batch_entry __user *entries = (struct get_batch_entry __user *) args->entries;
+
+	if (args->nr > BATCH_MAX)
+		return -EINVAL;
+
+	for (args->done = 0; args->done < args->nr; args->done++) {
+		if (copy_from_user(&entry, &(entries[args->done]), sizeof(entry)))
+			return -EFAULT;
+		entry.ret = get_data_user(sb, entry.block, (char __user *) entry.destination, entry.size);
+		if (entry.ret == -ENODEV)
+			return -ENODEV;
+		if (put_user(entry.ret, &(entries[args->done].ret)))
+			return -EFAULT;
+	}
+	args->seq = 0;
 
 	return 0;
 }
 
+// Ioctl operation - servizi aggiuntivi rispetto alle system call
+long onefilefs_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+
+	int ret;
+	int follow;
+	uint64_t seq;
+	unsigned long long barrier_seq;
+	struct put_data_args put_args;
+	struct cursor_args cursor_args;
+	struct cursor_fetch_args fetch_args;
+	struct query_args query_args;
+	struct invalidate_args inv_args;
+	struct update_data_args update_args;
+	struct get_data_args get_args;
+	struct invalidate_data_args inv_data_args;
+	struct batch_args batch_args;
+	struct ring_setup_args ring_args;
+	struct onefilefs_file *f = file->private_data;
+	struct super_block *sb = f->sb;
+
+	switch (cmd) {
+		case IOCTL_PUT_DATA_ASYNC:
+			if (!(file->f_mode & FMODE_WRITE))
+				return -EBADF;
+			if (copy_from_user(&put_args, (void __user *) arg, sizeof(put_args)))
+				return -EFAULT;
+
+			ret = put_data_user(sb, f->chan, put_args.source, put_args.size, 1, &seq);
+			if (ret < 0)
+				return ret;
+
+			put_args.block = ret;
+			put_args.seq = seq;
+			if (copy_to_user((void __user *) arg, &put_args, sizeof(put_args)))
+				return -EFAULT;
+			return 0;
+
+		case IOCTL_PUT_DATA:
+			if (!(file->f_mode & FMODE_WRITE))
+				return -EBADF;
+			if (copy_from_user(&put_args, (void __user *) arg, sizeof(put_args)))
+				return -EFAULT;
+
+			ret = put_data_user(sb, f->chan, put_args.source, put_args.size, 0, &seq);
+			if (ret < 0)
+				return ret;
+
+			put_args.block = ret;
+			put_args.seq = seq;
+			if (copy_to_user((void __user *) arg, &put_args, sizeof(put_args)))
+				return -EFAULT;
+			return 0;
+
+		case IOCTL_GET_DATA:
+			if (copy_from_user(&get_args, (void __user *) arg, sizeof(get_args)))
+				return -EFAULT;
+
+			return get_data_user(sb, get_args.block, (char __user *) get_args.destination, get_args.size);
+
+		case IOCTL_INVALIDATE_DATA:
+			if (!(file->f_mode & FMODE_WRITE))
+				return -EBADF;
+			if (copy_from_user(&inv_data_args, (void __user *) arg, sizeof(inv_data_args)))
+				return -EFAULT;
+
+			ret = invalidate_data_user(sb, inv_data_args.block, &seq);
+			if (ret < 0)
+				return ret;
+
+			inv_data_args.seq = seq;
+			if (copy_to_user((void __user *) arg, &inv_data_args, sizeof(inv_data_args)))
+				return -EFAULT;
+			return 0;
+
+		case IOCTL_BARRIER:
+			if (copy_from_user(&barrier_seq, (void __user *) arg, sizeof(barrier_seq)))
+				return -EFAULT;
+
+			atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+			if (!FS_INFO(sb)->mounted) {
+				atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+				return -ENODEV;
+			}
+			ret = journal_wait_durable(sb, barrier_seq);
+			atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+
+			LOG printk("%s: [onefilefs_ioctl()] - barrier sulla sequenza %llu completata (ret=%d)\n", MODNAME, barrier_seq, ret);
+			return ret;
+
+		case IOCTL_FOLLOW:
+			if (copy_from_user(&follow, (void __user *) arg, sizeof(follow)))
+				return -EFAULT;
+
+			WRITE_ONCE(f->follow, (follow != 0));
+			// risveglio di eventuali read bloccate quando la follow mode viene disattivata
+			wake_up_interruptible(&(FS_INFO(sb)->chan[f->chan].read_wq));
+			return 0;
+
+		case IOCTL_CURSOR_OPEN:
+			if (copy_from_user(&cursor_args, (void __user *) arg, sizeof(cursor_args)))
+				return -EFAULT;
+
+			mutex_lock(&(f->cur_lock));
+			ret = onefilefs_cursor_open(f, &cursor_args);
+			mutex_unlock(&(f->cur_lock));
+			return ret;
+
+		case IOCTL_CURSOR_FETCH:
+			if (copy_from_user(&fetch_args, (void __user *) arg, sizeof(fetch_args)))
+				return -EFAULT;
+
+			atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+			if (!FS_INFO(sb)->mounted) {
+				atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+				return -ENODEV;
+			}
+			mutex_lock(&(f->cur_lock));
+			ret = onefilefs_fetch(sb, f->chan, &(f->cur_seq), &(f->cur_block), fetch_args.buf, fetch_args.size, fetch_args.max, &(fetch_args.count));
+			fetch_args.seq = f->cur_seq;
+			mutex_unlock(&(f->cur_lock));
+			atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+			if (ret < 0)
+				return ret;
+
+			if (copy_to_user((void __user *) arg, &fetch_args, sizeof(fetch_args)))
+				return -EFAULT;
+			return 0;
+
+		case IOCTL_QUERY_SINCE:
+			if (copy_from_user(&query_args, (void __user *) arg, sizeof(query_args)))
+				return -EFAULT;
+
+			atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+			if (!FS_INFO(sb)->mounted) {
+				atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+				return -ENODEV;
+			}
+			ret = onefilefs_query_since(sb, f->chan, &query_args);
+			atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+			if (ret < 0)
+				return ret;
+
+			if (copy_to_user((void __user *) arg, &query_args, sizeof(query_args)))
+				return -EFAULT;
+			return 0;
+
+		case IOCTL_INVALIDATE_BULK:
+			if (!(file->f_mode & FMODE_WRITE))
+				return -EBADF;
+			if (copy_from_user(&inv_args, (void __user *) arg, sizeof(inv_args)))
+				return -EFAULT;
+
+			ret = invalidate_data_bulk(sb, f->chan, inv_args.by, (int __user *) inv_args.offsets, inv_args.nr, inv_args.from, inv_args.to, &seq);
+			if (ret < 0)
+				return ret;
+
+			inv_args.count = ret;
+			inv_args.seq = (ret > 0) ? seq : 0;
+			if (copy_to_user((void __user *) arg, &inv_args, sizeof(inv_args)))
+				return -EFAULT;
+			return 0;
+
+		case IOCTL_UPDATE_DATA:
+			if (!(file->f_mode & FMODE_WRITE))
+				return -EBADF;
+			if (copy_from_user(&update_args, (void __user *) arg, sizeof(update_args)))
+				return -EFAULT;
+
+			ret = update_data_user(sb, update_args.block, (char __user *) update_args.source, update_args.size, &seq);
+			if (ret < 0)
+				return ret;
+
+			update_args.seq = seq;
+			if (copy_to_user((void __user *) arg, &update_args, sizeof(update_args)))
+				return -EFAULT;
+			return ret;
+
+		case IOCTL_APPEND_DATA:
+			if (!(file->f_mode & FMODE_WRITE))
+				return -EBADF;
+			if (copy_from_user(&update_args, (void __user *) arg, sizeof(update_args)))
+				return -EFAULT;
+
+			ret = append_data_user(sb, update_args.block, (char __user *) update_args.source, update_args.size, &seq);
+			if (ret < 0)
+				return ret;
+
+			update_args.seq = seq;
+			if (copy_to_user((void __user *) arg, &update_args, sizeof(update_args)))
+				return -EFAULT;
+			return ret;
+
+		case IOCTL_ABI_VERSION:
+			return BLOCKLEVEL_ABI_VERSION;
+
+		case IOCTL_PUT_BATCH:
+		case IOCTL_GET_BATCH:
+			if (cmd == IOCTL_PUT_BATCH && !(file->f_mode & FMODE_WRITE))
+				return -EBADF;
+			if (copy_from_user(&batch_args, (void __user *) arg, sizeof(batch_args)))
+				return -EFAULT;
+
+			if (cmd == IOCTL_PUT_BATCH)
+				ret = onefilefs_put_batch(sb, f->chan, &batch_args);
+			else
+				ret = onefilefs_get_batch(sb, &batch_args);
+			if (ret < 0 && batch_args.done == 0)
+				return ret;
+
+			if (copy_to_user((void __user *) arg, &batch_args, sizeof(batch_args)))
+				return -EFAULT;
+			return ret;
+
+		case IOCTL_RING_SETUP:
+			if (copy_from_user(&ring_args, (void __user *) arg, sizeof(ring_args)))
+				return -EFAULT;
+
+			ret = ring_setup(f, &ring_args);
+			if (ret < 0)
+				return ret;
+
+			if (copy_to_user((void __user *) arg, &ring_args, sizeof(ring_args)))
+				return -EFAULT;
+			return 0;
+
+		case IOCTL_RING_ENTER:
+			if (!(file->f_mode & FMODE_WRITE))
+				return -EBADF;
+			if (READ_ONCE(f->ring) == NULL)
+				return -EINVAL;
+			return ring_enter(sb, f->chan, f->ring);
+
+		case IOCTL_NOTIFY_FD:
+			ret = notify_open(sb);
+			LOG printk("%s: [onefilefs_ioctl()] - creato il file descriptor di notifica %d\n", MODNAME, ret);
+			return ret;
+
+		default:
+			return -ENOTTY;
+	}
+}
+
 const struct inode_operations onefilefs_inode_ops = {
     .lookup = onefilefs_lookup,
 };
 
+// Mmap operation - anelli di sottomissione e completamento allocati con IOCTL_RING_SETUP oppure, per i file del
+// file system, snapshot in sola lettura dei messaggi del canale
+int onefilefs_mmap(struct file *file, struct vm_area_struct *vma) {
+
+	struct onefilefs_file *f = file->private_data;
+	struct blocklevel_ring *ring = READ_ONCE(f->ring);
+
+	if (ring != NULL)
+		return ring_mmap(ring, vma);
+	if (f->sb != file_inode(file)->i_sb)
+		return -EINVAL;
+
+	return snapshot_mmap(f->sb, f->chan, vma);
+}
+
 const struct file_operations onefilefs_file_operations = {
-  .read = onefilefs_read,
+  .read_iter = onefilefs_read_iter,
+  .splice_read = onefilefs_splice_read,
+  .llseek = no_llseek,
   .open = onefilefs_open,
   .release = onefilefs_release,
+  .unlocked_ioctl = onefilefs_ioctl,
+  .fsync = onefilefs_fsync,
+  .poll = onefilefs_poll,
+  .mmap = onefilefs_mmap,
 };
\ No newline at end of file
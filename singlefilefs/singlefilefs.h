@@ -4,6 +4,8 @@
 #include <linux/types.h>
 #include <linux/fs.h>
 
+#include "../common_header.h"
+
 #define MAGIC 0x42424242
 #define SB_BLOCK_NUMBER 0
 #define DEFAULT_FILE_INODE_BLOCK 1
@@ -12,6 +14,8 @@
 #define SINGLEFILEFS_FILE_INODE_NUMBER 1
 #define SINGLEFILEFS_INODES_BLOCK_NUMBER 1
 #define UNIQUE_FILE_NAME "the-file"
+#define CHANNEL_FILE_PREFIX "channel-"		// file dei canali 1, ..., NCHANNELS-1
+#define SINGLEFILEFS_CHANNEL_INODE_NUMBER(c) ((c) == 0 ? SINGLEFILEFS_FILE_INODE_NUMBER : 20 + (c))
 
 // inode definition
 struct onefilefs_inode {
@@ -31,6 +35,12 @@ struct onefilefs_dir_record {
 	uint64_t inode_no;
 };
 
+// testa e coda della catena dei blocchi validi di un canale
+struct onefilefs_channel {
+	unsigned int first_valid;
+	unsigned int last_valid;
+};
+
 // superblock definition
 struct onefilefs_sb_info {
 	uint64_t version;
@@ -38,9 +48,13 @@ struct onefilefs_sb_info {
 	uint64_t block_size;
 	unsigned int first_valid;
 	unsigned int last_valid;
+	unsigned int journal_start;		// primo blocco della regione di journal
+	unsigned int journal_blocks;	// numero di blocchi della regione di journal
+	uint64_t journal_seq;			// primo blocco di journal non ancora riportato in-place (checkpoint)
+	struct onefilefs_channel channels[NCHANNELS-1];	// canali 1, ..., NCHANNELS-1 (il canale 0 usa first_valid e last_valid)
 
 	//padding to fit into a single block
-	char padding[(4 * 1024) - (3 * sizeof(uint64_t)) - (2 * sizeof(unsigned int))];
+	char padding[(4 * 1024) - (4 * sizeof(uint64_t)) - (4 * sizeof(unsigned int)) - ((NCHANNELS-1) * sizeof(struct onefilefs_channel))];
 };
 
 // file.c
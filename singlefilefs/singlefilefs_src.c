@@ -1,10 +1,15 @@
+#include <linux/bitmap.h>
 #include <linux/buffer_head.h>
 #include <linux/fs.h>
 #include <linux/init.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/parser.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/srcu.h>
+#include <linux/statfs.h>
 #include <linux/string.h>
 #include <linux/time.h>
 #include <linux/timekeeping.h>
@@ -13,33 +18,247 @@
 
 #include "../utils_header.h"
 
+#define DEFAULT_MOUNT_OPTIONS {                     \
+    .commit_mode = DEFAULT_COMMIT_MODE,             \
+    .commit_interval = DEFAULT_COMMIT_INTERVAL,     \
+    .debug = DEFAULT_LOG_LEVEL,                     \
+    .ttl = 0,                                       \
+    .max_msgs = 0,                                  \
+    .stripe = NULL,                                 \
+    .mirror = NULL,                                 \
+    .quorum = 2,                                    \
+    .render_cache = DEFAULT_RENDER_CACHE,           \
+    .read_stage = 1,                                \
+}
+
+// opzioni di montaggio (sync e async sono consumate da mount(8) come flag generici, da cui mode=)
+enum {
+    Opt_sync, Opt_async, Opt_group_commit, Opt_commit, Opt_debug, Opt_ttl, Opt_max_msgs, Opt_stripe, Opt_mirror, Opt_quorum, Opt_render_cache, Opt_read_stage, Opt_err
+};
+
+static const match_table_t singlefilefs_tokens = {
+    {Opt_sync, "mode=sync"},
+    {Opt_async, "mode=async"},
+    {Opt_group_commit, "mode=group_commit"},
+    {Opt_commit, "commit=%d"},
+    {Opt_debug, "debug=%d"},
+    {Opt_ttl, "ttl=%d"},
+    {Opt_max_msgs, "max_msgs=%d"},
+    {Opt_stripe, "stripe=%s"},
+    {Opt_mirror, "mirror=%s"},
+    {Opt_quorum, "quorum=%d"},
+    {Opt_render_cache, "render_cache=%d"},
+    {Opt_read_stage, "read_stage=%d"},
+    {Opt_err, NULL}
+};
+
+static const char * const commit_mode_names[] = {
+    [COMMIT_SYNC] = "sync",
+    [COMMIT_ASYNC] = "async",
+    [COMMIT_GROUP] = "group_commit",
+};
+
+static int singlefilefs_parse_options(char *data, struct mount_options *opts) {
+
+    char *p;
+    int token;
+    int value;
+    substring_t args[MAX_OPT_ARGS];
+
+    if (!data)
+        return 0;
+
+    while ((p = strsep(&data, ",")) != NULL) {
+        if (!*p)
+            continue;
+
+        token = match_token(p, singlefilefs_tokens, args);
+        switch (token) {
+        case Opt_sync:
+            opts->commit_mode = COMMIT_SYNC;
+            break;
+        case Opt_async:
+            opts->commit_mode = COMMIT_ASYNC;
+            break;
+        case Opt_group_commit:
+            opts->commit_mode = COMMIT_GROUP;
+            break;
+        case Opt_commit:
+            if (match_int(&args[0], &value) || value <= 0 || value > MAX_COMMIT_INTERVAL)
+                goto parse_error;
+            opts->commit_interval = value;
+            break;
+        case Opt_debug:
+            if (match_int(&args[0], &value) || value < LOG_ERR || value > LOG_AUDIT)
+                goto parse_error;
+            opts->debug = value;
+            break;
+        case Opt_ttl:
+            if (match_int(&args[0], &value) || value < 0)
+                goto parse_error;
+            opts->ttl = value;
+            break;
+        case Opt_max_msgs:
+            if (match_int(&args[0], &value) || value < 0)
+                goto parse_error;
+            opts->max_msgs = value;
+            break;
+        case Opt_stripe:
+            kfree(opts->stripe);
+            opts->stripe = match_strdup(&args[0]);
+            if (!opts->stripe)
+                return -ENOMEM;
+            break;
+        case Opt_mirror:
+            kfree(opts->mirror);
+            opts->mirror = match_strdup(&args[0]);
+            if (!opts->mirror)
+                return -ENOMEM;
+            break;
+        case Opt_quorum:
+            if (match_int(&args[0], &value) || value < 1 || value > 2)
+                goto parse_error;
+            opts->quorum = value;
+            break;
+        case Opt_render_cache:
+            if (match_int(&args[0], &value) || value < 0)
+                goto parse_error;
+            opts->render_cache = value;
+            break;
+        case Opt_read_stage:
+            if (match_int(&args[0], &value) || value < 0 || value > 1)
+                goto parse_error;
+            opts->read_stage = value;
+            break;
+        default:
+            goto parse_error;
+        }
+    }
+
+    return 0;
+
+parse_error:
+    printk(KERN_CRIT "%s: opzione di montaggio non valida: %s\n", MODNAME, p);
+    return -EINVAL;
+}
+
+// opzioni del montaggio corrente riportate in /proc/mounts
+static int singlefilefs_show_options(struct seq_file *m, struct dentry *root) {
+
+    struct mount_options *opts = &(FS_INFO(root->d_sb)->opts);
+
+    seq_printf(m, ",mode=%s", commit_mode_names[opts->commit_mode]);
+    seq_printf(m, ",commit=%u", opts->commit_interval);
+    seq_printf(m, ",render_cache=%u", opts->render_cache);
+    seq_printf(m, ",read_stage=%u", opts->read_stage);
+    seq_printf(m, ",debug=%u", opts->debug);
+    if (opts->ttl)
+        seq_printf(m, ",ttl=%u", opts->ttl);
+    if (opts->max_msgs)
+        seq_printf(m, ",max_msgs=%u", opts->max_msgs);
+    if (opts->stripe)
+        seq_printf(m, ",stripe=%s", opts->stripe);
+    if (opts->mirror)
+        seq_printf(m, ",mirror=%s,quorum=%u", opts->mirror, opts->quorum);
+
+    return 0;
+}
+
+// statistiche del file system: blocchi dati liberi e occupati (compresi quelli di continuazione) dai contatori in memoria
+static int singlefilefs_statfs(struct dentry *dentry, struct kstatfs *buf) {
+
+    struct super_block *sb = dentry->d_sb;
+
+    buf->f_type = sb->s_magic;
+    buf->f_bsize = DEFAULT_BLOCK_SIZE;
+    buf->f_blocks = NBLOCKS-2;
+    buf->f_bfree = NBLOCKS-2 - READ_ONCE(FS_INFO(sb)->nr_used);
+    buf->f_bavail = buf->f_bfree;
+    buf->f_files = NCHANNELS;
+    buf->f_ffree = 0;
+    buf->f_namelen = NAME_MAX;
+
+    return 0;
+}
+
 static struct super_operations singlefilefs_super_ops = {
+    .show_options = singlefilefs_show_options,
+    .statfs = singlefilefs_statfs,
 };
 
 static struct dentry_operations singlefilefs_dentry_ops = {
 };
 
-struct filesystem_info fs_info = {0};   // extern in utils_header.h
-struct super_block *global_sb;          // extern in utils_header.h
+// montaggi attivi (in ordine di montaggio): il primo è quello su cui operano le system call
+static LIST_HEAD(singlefilefs_mounts);
+static DEFINE_SPINLOCK(singlefilefs_mounts_lock);
+
+// restituisce il montaggio predefinito (il primo ancora attivo) mantenendolo attivo fino a deactivate_super(),
+// oppure NULL se non ci sono montaggi
+struct super_block *singlefilefs_get_default(void) {
+
+    struct filesystem_info *fsi;
+    struct super_block *sb = NULL;
+
+    spin_lock(&singlefilefs_mounts_lock);
+    list_for_each_entry(fsi, &singlefilefs_mounts, mounts) {
+        if (atomic_inc_not_zero(&(fsi->sb->s_active))) {
+            sb = fsi->sb;
+            break;
+        }
+    }
+    spin_unlock(&singlefilefs_mounts_lock);
+
+    return sb;
+}
+
+// rilascio delle strutture in memoria associate al montaggio
+static void singlefilefs_free_info(struct super_block *sb) {
+
+    struct filesystem_info *fsi = FS_INFO(sb);
+
+    kfree(fsi->block_seq);
+    kfree(fsi->block_time);
+    kfree(fsi->block_chan);
+    render_free(sb);
+    mirror_close(sb);
+    stripe_close(sb);
+    kfree(fsi->opts.stripe);
+    kfree(fsi->opts.mirror);
+    bitmap_free(fsi->dirty_map);
+    cleanup_srcu_struct(&(fsi->srcu));
+    kvfree(fsi);
+    sb->s_fs_info = NULL;
+}
 
 int singlefilefs_fill_super(struct super_block *sb, void *data, int silent) {
 
     struct inode *root_inode;
     struct buffer_head *bh;
     struct onefilefs_sb_info *sb_disk;
+    struct filesystem_info *fsi;
     struct timespec64 curr_time;
+    struct mount_options opts = DEFAULT_MOUNT_OPTIONS;
     uint64_t magic;
+    int ret;
+    int i;
+
+    // opzioni di montaggio: -o sync seleziona i commit sincroni, mode= ha comunque la precedenza
+    if (sb->s_flags & SB_SYNCHRONOUS)
+        opts.commit_mode = COMMIT_SYNC;
+    ret = singlefilefs_parse_options(data, &opts);
+    if (ret < 0) {
+        goto opts_error;
+    }
     
     // Unique identifier of the filesystem
     sb->s_magic = MAGIC;
 
-    // inizializzazione variabile superblocco globale
-    global_sb = sb;
-
     // lettura del superblocco del file system
     bh = sb_bread(sb, SB_BLOCK_NUMBER);
-    if (!sb) {
-	    return -EIO;
+    if (!bh) {
+        ret = -EIO;
+        goto opts_error;
     }
     sb_disk = (struct onefilefs_sb_info *)bh->b_data;
     magic = sb_disk->magic;
@@ -47,15 +266,94 @@ int singlefilefs_fill_super(struct super_block *sb, void *data, int silent) {
 
     // check on the expected magic number
     if (magic != sb->s_magic) {
-	    return -EBADF;
+        ret = -EBADF;
+        goto opts_error;
     }
 
-    sb->s_fs_info = NULL;                               // FS specific data (the magic number) already reported into the generic superblock
     sb->s_op = &singlefilefs_super_ops;                 // set our own operations
 
+    // stato in memoria del montaggio (FS specific data)
+    fsi = kvzalloc(sizeof(struct filesystem_info), GFP_KERNEL);
+    if (!fsi) {
+        ret = -ENOMEM;
+        goto opts_error;
+    }
+    ret = init_srcu_struct(&(fsi->srcu));
+    if (ret != 0) {
+        kvfree(fsi);
+        goto opts_error;
+    }
+    fsi->sb = sb;
+    fsi->opts = opts;
+    INIT_LIST_HEAD(&(fsi->mounts));
+    INIT_LIST_HEAD(&(fsi->notify_list));
+    spin_lock_init(&(fsi->notify_lock));
+    INIT_DELAYED_WORK(&(fsi->retention_work), retention_work);
+    mutex_init(&(fsi->write_lock));
+    sb->s_fs_info = fsi;
+
+    // mappa dei blocchi del device con buffer dirty da scrivere
+    fsi->nr_dev_blocks = i_size_read(sb->s_bdev->bd_inode) >> sb->s_blocksize_bits;
+    fsi->dirty_map = bitmap_zalloc(fsi->nr_dev_blocks, GFP_KERNEL);
+    init_waitqueue_head(&(fsi->wb_wq));
+
+    // sequenze, istanti di inserimento e canali dei messaggi (caricati da check_chain() per i blocchi già presenti)
+    fsi->block_seq = kcalloc(NBLOCKS-2, sizeof(uint64_t), GFP_KERNEL);
+    fsi->block_time = kcalloc(NBLOCKS-2, sizeof(int64_t), GFP_KERNEL);
+    fsi->block_chan = kcalloc(NBLOCKS-2, sizeof(unsigned int), GFP_KERNEL);
+    if (!fsi->dirty_map || !fsi->block_seq || !fsi->block_time || !fsi->block_chan) {
+        singlefilefs_free_info(sb);
+        return -ENOMEM;
+    }
+    xa_init(&(fsi->seq_index));
+    for (i = 0; i < NCHANNELS; i++) {
+        mutex_init(&(fsi->chan[i].lock));
+        init_waitqueue_head(&(fsi->chan[i].read_wq));
+        mutex_init(&(fsi->chan[i].render.lock));
+        ktime_get_real_ts64(&(fsi->chan[i].mtime));
+    }
+    for (i = 0; i < NBLOCKS-2; i++)
+        seqcount_mutex_init(&(fsi->block_sc[i]), &(fsi->write_lock));
+
+    // device aggiuntivi del volume striped (necessari già per il replay del journal)
+    ret = stripe_open(sb);
+    if (ret < 0) {
+        singlefilefs_free_info(sb);
+        return ret;
+    }
+
+    // device di mirror, riallineato prima del replay del journal (che viene poi replicato su entrambe le copie)
+    ret = mirror_open(sb);
+    if (ret < 0) {
+        singlefilefs_free_info(sb);
+        return ret;
+    }
+
+    // replay del journal e ripristino della consistenza della catena dei blocchi validi
+    ret = journal_load(sb);
+    if (ret < 0) {
+        singlefilefs_free_info(sb);
+        return ret;
+    }
+    ret = check_chain(sb);
+    if (ret < 0) {
+        printk(KERN_CRIT "%s: errore durante il controllo della catena dei blocchi validi\n", MODNAME);
+        goto fill_error;
+    }
+
+    // thread di writeback dei buffer dirty e del checkpoint del journal
+    ret = writeback_start(sb);
+    if (ret < 0) {
+        goto fill_error;
+    }
+
+    // eliminazione in background dei messaggi scaduti
+    retention_start(sb);
+
     root_inode = iget_locked(sb, 0);                    // get a root inode indexed with 0 from cache
     if (!root_inode) {
-        return -ENOMEM;
+        ret = -ENOMEM;
+        goto fill_error;
     }
     
     root_inode->i_ino = SINGLEFILEFS_ROOT_INODE_NUMBER; // this is actually 10
@@ -75,35 +373,65 @@ int singlefilefs_fill_super(struct super_block *sb, void *data, int silent) {
     root_inode->i_private = NULL;
 
     sb->s_root = d_make_root(root_inode);
-    if (!sb->s_root)
-        return -ENOMEM;
+    if (!sb->s_root) {
+        ret = -ENOMEM;
+        goto fill_error;
+    }
 
     sb->s_root->d_op = &singlefilefs_dentry_ops;  // set our dentry operations
 
     // unlock the inode to make it usable
     unlock_new_inode(root_inode);
 
+    fsi->mounted = 1;
+
     return 0;
+
+fill_error:
+    retention_stop(sb);
+    writeback_stop(sb);
+    journal_unload(sb);
+    xa_destroy(&(fsi->seq_index));
+    singlefilefs_free_info(sb);
+    return ret;
+
+opts_error:
+    kfree(opts.stripe);
+    kfree(opts.mirror);
+    return ret;
 }
 
 static void singlefilefs_kill_superblock(struct super_block *s) {
     
-    long unsigned int mounted_curr;
+    struct filesystem_info *fsi = FS_INFO(s);
+    int i;
 
-    if (atomic_read(&(fs_info.usage)) != 0) {
-        printk("%s: smontaggio del file system impossibile, qualche thread sta eseguendo qualche operazione\n", MODNAME);
+    // montaggio fallito: lo stato in memoria è già stato rilasciato da singlefilefs_fill_super()
+    if (fsi == NULL) {
+        kill_block_super(s);
         return;
     }
 
-    mounted_curr = __sync_val_compare_and_swap(&(fs_info.mounted), 1, 0);
-    if (mounted_curr != 1) {
-        printk("%s: il file system è già stato smontato\n", MODNAME);
-        return;
-    }
+    // nessuna nuova system call può selezionare il montaggio, mentre quelle in corso (come i file aperti)
+    // lo mantengono attivo, quindi a questo punto nessun thread sta utilizzando il file system
+    spin_lock(&singlefilefs_mounts_lock);
+    list_del_init(&(fsi->mounts));
+    spin_unlock(&singlefilefs_mounts_lock);
+
+    if (atomic_read(&(fsi->usage)) != 0)
+        printk(KERN_CRIT "%s: smontaggio del device %s con %d operazioni in corso\n", MODNAME, s->s_id, atomic_read(&(fsi->usage)));
+
+    WRITE_ONCE(fsi->mounted, 0);
+    for (i = 0; i < NCHANNELS; i++)
+        wake_up_interruptible_all(&(fsi->chan[i].read_wq));     // risveglio dei lettori in follow mode
 
-    cleanup_srcu_struct(&(fs_info.srcu)); // reset srcu_struct
+    retention_stop(s);                    // arresto del worker di retention
+    writeback_stop(s);                    // arresto del thread di writeback
+    journal_unload(s);                    // checkpoint finale del journal
+    xa_destroy(&(fsi->seq_index));
 
     kill_block_super(s);
+    singlefilefs_free_info(s);            // reset srcu_struct e rilascio dello stato del montaggio
     printk("%s: singlefilefs smontato con successo\n", MODNAME);
 
     return;
@@ -112,29 +440,23 @@ static void singlefilefs_kill_superblock(struct super_block *s) {
 struct dentry *singlefilefs_mount(struct file_system_type *fs_type, int flags, const char *dev_name, void *data) {
     
     struct dentry *d_ret;
-    unsigned int mounted;
-    int ret;
-
-    mutex_init(&(fs_info.write_lock));
+    struct filesystem_info *fsi;
 
-    ret = init_srcu_struct(&(fs_info.srcu));
-    if (ret != 0) {
-        printk(KERN_CRIT "%s: errore durante il montaggio del filesystem", MODNAME);
-        return ERR_PTR(-ENOMEM);
+    // ogni device ha un proprio montaggio indipendente (superblocco e stato in memoria)
+    d_ret = mount_bdev(fs_type, flags, dev_name, data, singlefilefs_fill_super);
+    if (unlikely(IS_ERR(d_ret))) {
+        printk(KERN_CRIT "%s: errore durante il montaggio del filesystem dal dispositivo %s", MODNAME, dev_name);
+        return d_ret;
     }
 
-    // controllo se il filesystem è già montato (utilizzo del compare and swap per far fronte a scenari concorrenti)
-    mounted = __sync_val_compare_and_swap(&(fs_info.mounted), 0, 1);
-    if (mounted != 0) {
-        printk("%s: il device driver supporta un solo montaggio alla volta (mounted=%d)\n", MODNAME, fs_info.mounted);
-        return ERR_PTR(-EBUSY);
-    }
+    // registrazione tra i montaggi attivi (un device già montato riutilizza il superblocco esistente)
+    fsi = FS_INFO(d_ret->d_sb);
+    spin_lock(&singlefilefs_mounts_lock);
+    if (list_empty(&(fsi->mounts)))
+        list_add_tail(&(fsi->mounts), &singlefilefs_mounts);
+    spin_unlock(&singlefilefs_mounts_lock);
 
-    d_ret = mount_bdev(fs_type, flags, dev_name, data, singlefilefs_fill_super);
-    if (unlikely(IS_ERR(d_ret))) 
-        printk(KERN_CRIT "%s: errore durante il montaggio del filesystem", MODNAME);
-    else 
-        printk("%s: singlefilefs montato con successo dal dispositivo %s\n", MODNAME, dev_name);
+    printk("%s: singlefilefs montato con successo dal dispositivo %s\n", MODNAME, dev_name);
     
     return d_ret;
 }
@@ -14,7 +14,8 @@
 	This makefs will write the following information onto the disk
 	- BLOCK 0, superblock
 	- BLOCK 1, inode of the unique file (the inode for root is volatile)
-	- BLOCK 2, ..., BLOCK N, metadata + data
+	- BLOCK 2, ..., BLOCK N-1, metadata + data
+	- BLOCK N, ..., BLOCK N+JOURNAL_BLOCKS-1, journal (zeroed)
 */
 
 int main(int argc, char *argv[]) {
@@ -22,6 +23,7 @@ int main(int argc, char *argv[]) {
     int i, fd, nbytes, nblocks;
     ssize_t ret;
     unsigned int metadata, next;
+    char header[METADATA_SIZE];
     struct onefilefs_sb_info sb;
     struct onefilefs_inode root_inode;
     struct onefilefs_inode file_inode;
@@ -49,6 +51,13 @@ int main(int argc, char *argv[]) {
     sb.block_size = DEFAULT_BLOCK_SIZE;
     sb.first_valid = (unsigned int) -1;
     sb.last_valid = (unsigned int) -1;
+    sb.journal_start = nblocks;
+    sb.journal_blocks = JOURNAL_BLOCKS;
+    sb.journal_seq = 1;
+    for (i = 0; i < NCHANNELS-1; i++) {
+        sb.channels[i].first_valid = (unsigned int) -1;
+        sb.channels[i].last_valid = (unsigned int) -1;
+    }
 
     ret = write(fd, (char *)&sb, sizeof(sb));
 	if (ret != DEFAULT_BLOCK_SIZE) {
@@ -94,7 +103,10 @@ int main(int argc, char *argv[]) {
             next = 0;
         metadata = set_invalid((unsigned int)-1);
 
-        ret = write(fd, &metadata, METADATA_SIZE);
+        // next_block followed by len, seq, timestamp, cont_block and flags (zero for an invalid block)
+        memset(header, 0, METADATA_SIZE);
+        memcpy(header, &metadata, sizeof(metadata));
+        ret = write(fd, header, METADATA_SIZE);
         if (ret != METADATA_SIZE) {
 			printf("Writing file metadata has failed.\n");
 			close(fd);
@@ -133,6 +145,19 @@ int main(int argc, char *argv[]) {
         printf("(%d/%d) File datablock has been written successfully\n\n", i+3, nblocks);
     }
 
+    // journal blocks (a zeroed block is never a valid journal block)
+    block_padding = malloc(DEFAULT_BLOCK_SIZE);
+    memset(block_padding, 0, DEFAULT_BLOCK_SIZE);
+    for (i = 0; i < JOURNAL_BLOCKS; i++) {
+        ret = write(fd, block_padding, DEFAULT_BLOCK_SIZE);
+        if (ret != DEFAULT_BLOCK_SIZE) {
+            printf("Writing journal block has failed\n");
+            close(fd);
+            return -1;
+        }
+    }
+    printf("Journal (%d blocks) written successfully\n", JOURNAL_BLOCKS);
+
     close(fd);
 
     return 0;
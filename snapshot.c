@@ -0,0 +1,190 @@
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/srcu.h>
+
+#include "utils_header.h"
+
+/*
+    Snapshot in sola lettura di the-file (e dei file dei canali) tramite mmap, per i consumatori che analizzano
+    i messaggi senza copie nello spazio utente: la mappatura inizia con una tabella (struct snapshot_header seguita
+    da una struct snapshot_entry per ogni porzione di messaggio, nell'ordine della catena) costruita al momento della
+    mmap, seguita da una pagina per ciascun blocco dati. Le pagine dei blocchi sono copie private, prese insieme alla
+    tabella, e non una mappatura dei blocchi del device: le pagine della page cache resterebbero mappate anche dopo
+    l'invalidazione e il riutilizzo del blocco o lo smontaggio del device, per cui lo snapshot costa una copia per
+    blocco al momento della mmap e non segue le modifiche successive (una nuova mmap prende un nuovo snapshot).
+    I blocchi che non compaiono nella tabella non vengono mappati.
+*/
+
+#define SNAPSHOT_TABLE_SIZE (sizeof(struct snapshot_header) + (NBLOCKS-2) * sizeof(struct snapshot_entry))
+#define SNAPSHOT_TABLE_PAGES DIV_ROUND_UP(SNAPSHOT_TABLE_SIZE, PAGE_SIZE)
+#define SNAPSHOT_SIZE ((SNAPSHOT_TABLE_PAGES + NBLOCKS-2) * PAGE_SIZE)
+
+// copia il blocco dati block_num nella relativa pagina privata dello snapshot (allocata al primo utilizzo)
+static struct bdev_layout *snapshot_copy_block(struct super_block *sb, struct page **pages, unsigned int block_num) {
+
+    struct bdev_layout *bdev_blk;
+
+    bdev_blk = get_block(sb, blk_offset(block_num));
+    if (bdev_blk == NULL)
+        return ERR_PTR(-EIO);
+    if (pages[block_num] == NULL) {
+        pages[block_num] = alloc_page(GFP_KERNEL);
+        if (!pages[block_num])
+            return ERR_PTR(-ENOMEM);
+    }
+    memcpy(page_address(pages[block_num]), bdev_blk, sizeof(struct bdev_layout));
+
+    return (struct bdev_layout *) page_address(pages[block_num]);
+}
+
+// costruisce la tabella dei messaggi del canale chan copiando le pagine dei relativi blocchi
+static int snapshot_build(struct super_block *sb, unsigned int chan, struct page **pages, char *table) {
+
+    int len;
+    unsigned int block;
+    unsigned int cont;
+    unsigned int first;
+    unsigned int sc;
+    unsigned int hops = 0;
+    uint64_t seq;
+    struct snapshot_header *hdr = (struct snapshot_header *) table;
+    struct snapshot_entry *entries = (struct snapshot_entry *) (table + sizeof(struct snapshot_header));
+    struct onefilefs_sb_info *sb_disk;
+    struct bdev_layout *bdev_blk;
+    struct bdev_layout *cont_blk;
+
+    hdr->data_off = SNAPSHOT_TABLE_PAGES * PAGE_SIZE;
+    hdr->size = SNAPSHOT_SIZE;
+    hdr->seq = smp_load_acquire(&(FS_INFO(sb)->chan[chan].msg_seq));
+
+    sb_disk = get_sb_info(sb);
+    if (sb_disk == NULL)
+        return -EIO;
+
+    block = chan_first_valid(sb_disk, chan);
+    while (block < NBLOCKS-2 && hops++ < NBLOCKS-2) {
+        bdev_blk = get_block(sb, blk_offset(block));
+        if (bdev_blk == NULL)
+            return -EIO;
+        seq = READ_ONCE(FS_INFO(sb)->block_seq[block]);
+        if (!block_is_message(bdev_blk) || seq > hdr->seq)
+            break;
+
+        // primo blocco del messaggio e blocchi di continuazione, ciascuno con la propria voce: le copie vengono
+        // ripetute se si sovrappongono a un aggiornamento in-place o a un accodamento del messaggio
+        first = hdr->nr;
+        do {
+            sc = read_seqcount_begin(&(FS_INFO(sb)->block_sc[block]));
+            hdr->nr = first;
+            cont = block;
+            while (hdr->nr < NBLOCKS-2) {
+                cont_blk = snapshot_copy_block(sb, pages, cont);
+                if (IS_ERR(cont_blk))
+                    return PTR_ERR(cont_blk);
+                entries[hdr->nr].seq = seq;
+                entries[hdr->nr].offset = hdr->data_off + cont * PAGE_SIZE + METADATA_SIZE;
+                len = block_data_len(cont_blk);
+                if (len < 0)
+                    return len;
+                entries[hdr->nr].len = len;
+                entries[hdr->nr].block = cont;
+                entries[hdr->nr].flags = (cont == block) ? 0 : SNAPSHOT_CONT;
+                hdr->nr++;
+
+                cont = cont_blk->cont_block;
+                if (!get_validity(cont) || get_block_num(cont) >= NBLOCKS-2)
+                    break;
+                cont = get_block_num(cont);
+            }
+        } while (read_seqcount_retry(&(FS_INFO(sb)->block_sc[block]), sc));
+
+        block = get_block_num(READ_ONCE(bdev_blk->next_block));
+    }
+
+    return 0;
+}
+
+// mmap in sola lettura dello snapshot del canale del file aperto
+int snapshot_mmap(struct super_block *sb, unsigned int chan, struct vm_area_struct *vma) {
+
+    int ret;
+    int i;
+    int srcu_idx;
+    unsigned long addr;
+    struct page *page;
+    struct page **pages;
+    struct snapshot_header *hdr;
+    struct snapshot_entry *entries;
+    char *table;
+
+    if (PAGE_SIZE != DEFAULT_BLOCK_SIZE || vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > SNAPSHOT_SIZE)
+        return -EINVAL;
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+    vma->vm_flags &= ~VM_MAYWRITE;
+
+    table = kvzalloc(SNAPSHOT_TABLE_PAGES * PAGE_SIZE, GFP_KERNEL);
+    pages = kvcalloc(NBLOCKS-2, sizeof(struct page *), GFP_KERNEL);
+    if (!table || !pages) {
+        kvfree(table);
+        kvfree(pages);
+        return -ENOMEM;
+    }
+    hdr = (struct snapshot_header *) table;
+    entries = (struct snapshot_entry *) (table + sizeof(struct snapshot_header));
+
+    // incremento del contatore atomico degli utilizzi del file system
+    atomic_fetch_add(1, &(FS_INFO(sb)->usage));
+    if (!FS_INFO(sb)->mounted) {
+        ret = -ENODEV;
+        goto snapshot_exit;
+    }
+
+    // la tabella e le copie dei blocchi vengono raccolte nella stessa sezione di lettura (i blocchi non possono
+    // essere riutilizzati prima della fine del grace period)
+    srcu_idx = srcu_read_lock(&(FS_INFO(sb)->srcu));
+    ret = snapshot_build(sb, chan, pages, table);
+    srcu_read_unlock(&(FS_INFO(sb)->srcu), srcu_idx);
+    if (ret < 0)
+        goto snapshot_exit;
+
+    // pagine della tabella (il riferimento viene mantenuto dalla mappatura)
+    for (i = 0; i < SNAPSHOT_TABLE_PAGES; i++) {
+        page = alloc_page(GFP_KERNEL);
+        if (!page) {
+            ret = -ENOMEM;
+            goto snapshot_exit;
+        }
+        memcpy(page_address(page), table + i * PAGE_SIZE, PAGE_SIZE);
+        if (vma->vm_start + i * PAGE_SIZE < vma->vm_end)
+            ret = vm_insert_page(vma, vma->vm_start + i * PAGE_SIZE, page);
+        put_page(page);
+        if (ret < 0)
+            goto snapshot_exit;
+    }
+
+    // copie dei blocchi presenti nella tabella (quelle scartate da un tentativo ripetuto non vengono mappate)
+    for (i = 0; i < hdr->nr; i++) {
+        addr = vma->vm_start + (SNAPSHOT_TABLE_PAGES + entries[i].block) * PAGE_SIZE;
+        if (addr >= vma->vm_end)
+            continue;
+        ret = vm_insert_page(vma, addr, pages[entries[i].block]);
+        if (ret < 0)
+            goto snapshot_exit;
+    }
+
+    LOG printk("%s: [snapshot_mmap()] - mappati %u blocchi del canale %u\n", MODNAME, hdr->nr, chan);
+
+snapshot_exit:
+    atomic_fetch_add(-1, &(FS_INFO(sb)->usage));
+    for (i = 0; i < NBLOCKS-2; i++) {
+        if (pages[i])
+            put_page(pages[i]);
+    }
+    kvfree(pages);
+    kvfree(table);
+    return ret;
+}
@@ -0,0 +1,159 @@
+#include <linux/blkdev.h>
+#include <linux/buffer_head.h>
+#include <linux/fs.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "utils_header.h"
+
+/*
+    Volume striped: con l'opzione di montaggio stripe=dev1:dev2:... i blocchi dati vengono distribuiti
+    round-robin tra il device del montaggio e i device aggiuntivi (il blocco dati i risiede sul device
+    i % N, allo stesso indice di blocco), quindi blocchi consecutivi di una catena vengono scritti e letti
+    in parallelo su device diversi: la sottomissione dei blocchi dati del commit e quella del writeback
+    precedono sempre l'attesa del completamento. Superblocco, inode e journal restano sul device del
+    montaggio, mentre ogni device aggiuntivo deve essere formattato con singlefilemakefs.
+*/
+
+#define STRIPE_MODE (FMODE_READ | FMODE_WRITE | FMODE_EXCL)
+
+// restituisce il device che contiene il blocco block_num del volume
+struct block_device *block_bdev(struct super_block *sb, unsigned int block_num) {
+
+    struct filesystem_info *fsi = FS_INFO(sb);
+
+    if (fsi->nr_stripes <= 1 || block_num < blk_offset(0) || block_num >= NBLOCKS)
+        return sb->s_bdev;
+
+    return fsi->stripe_bdev[(block_num - blk_offset(0)) % fsi->nr_stripes];
+}
+
+// lettura di un blocco del volume (dal device su cui risiede oppure dalla copia di mirror)
+struct buffer_head *bread_block(struct super_block *sb, unsigned int block_num) {
+
+    struct buffer_head *bh;
+    struct block_device *bdev = block_bdev(sb, block_num);
+
+    if (FS_INFO(sb)->mirror_bdev == NULL)
+        return __bread(bdev, block_num, sb->s_blocksize);
+
+    bh = mirror_read(sb, bdev, block_num);
+    if (bh)
+        return bh;
+
+    atomic_inc(&(FS_INFO(sb)->mirror_reads[0]));
+    bh = __bread(bdev, block_num, sb->s_blocksize);
+    atomic_dec(&(FS_INFO(sb)->mirror_reads[0]));
+
+    return bh;
+}
+
+// buffer già presente in memoria di un blocco del volume (NULL se assente)
+struct buffer_head *find_block(struct super_block *sb, unsigned int block_num) {
+
+    struct block_device *bdev = block_bdev(sb, block_num);
+
+    if (bdev == sb->s_bdev)
+        return sb_find_get_block(sb, block_num);
+
+    return __find_get_block(bdev, block_num, sb->s_blocksize);
+}
+
+// controlla che il device aggiuntivo sia formattato e abbia spazio per tutti i blocchi dati
+static int stripe_check(struct super_block *sb, struct block_device *bdev, const char *path) {
+
+    int ret = 0;
+    struct buffer_head *bh;
+    struct onefilefs_sb_info *sb_disk;
+
+    if (set_blocksize(bdev, sb->s_blocksize) != 0 || (i_size_read(bdev->bd_inode) >> sb->s_blocksize_bits) < NBLOCKS) {
+        printk(KERN_CRIT "%s: [stripe] - il device %s non ha blocchi da %lu byte sufficienti\n", MODNAME, path, sb->s_blocksize);
+        return -EINVAL;
+    }
+
+    bh = __bread(bdev, SB_BLOCK_NUMBER, sb->s_blocksize);
+    if (!bh)
+        return -EIO;
+    sb_disk = (struct onefilefs_sb_info *) bh->b_data;
+    if (sb_disk->magic != MAGIC || sb_disk->block_size != DEFAULT_BLOCK_SIZE) {
+        printk(KERN_CRIT "%s: [stripe] - il device %s non è formattato come singlefilefs\n", MODNAME, path);
+        ret = -EINVAL;
+    }
+    brelse(bh);
+
+    return ret;
+}
+
+// apertura dei device aggiuntivi indicati dall'opzione stripe= (il device del montaggio è sempre il primo)
+int stripe_open(struct super_block *sb) {
+
+    int ret = 0;
+    char *paths;
+    char *next;
+    char *path;
+    struct block_device *bdev;
+    struct filesystem_info *fsi = FS_INFO(sb);
+
+    fsi->stripe_bdev[0] = sb->s_bdev;
+    fsi->nr_stripes = 1;
+    if (fsi->opts.stripe == NULL)
+        return 0;
+
+    paths = kstrdup(fsi->opts.stripe, GFP_KERNEL);
+    if (!paths)
+        return -ENOMEM;
+
+    next = paths;
+    while ((path = strsep(&next, ":")) != NULL) {
+        if (!*path)
+            continue;
+        if (fsi->nr_stripes >= MAX_STRIPES) {
+            printk(KERN_CRIT "%s: [stripe] - al più %d device per volume\n", MODNAME, MAX_STRIPES);
+            ret = -EINVAL;
+            break;
+        }
+
+        // apertura esclusiva: lo stesso device non può comparire due volte né essere montato separatamente
+        bdev = blkdev_get_by_path(path, STRIPE_MODE, sb);
+        if (IS_ERR(bdev)) {
+            printk(KERN_CRIT "%s: [stripe] - impossibile aprire il device %s\n", MODNAME, path);
+            ret = PTR_ERR(bdev);
+            break;
+        }
+        fsi->stripe_bdev[fsi->nr_stripes++] = bdev;
+
+        ret = stripe_check(sb, bdev, path);
+        if (ret < 0)
+            break;
+    }
+    kfree(paths);
+
+    if (ret < 0) {
+        stripe_close(sb);
+        return ret;
+    }
+
+    LOG printk("%s: [stripe] - volume su %u device\n", MODNAME, fsi->nr_stripes);
+
+    return 0;
+}
+
+// chiusura dei device aggiuntivi (i buffer dirty sono già stati scritti dal checkpoint finale)
+void stripe_close(struct super_block *sb) {
+
+    struct filesystem_info *fsi = FS_INFO(sb);
+
+    while (fsi->nr_stripes > 1)
+        blkdev_put(fsi->stripe_bdev[--fsi->nr_stripes], STRIPE_MODE);
+    fsi->nr_stripes = 0;
+}
+
+// lettura anticipata di tutti i blocchi dati, sottomessa in parallelo su tutti i device del volume
+void stripe_readahead(struct super_block *sb) {
+
+    int i;
+
+    for (i = 0; i < NBLOCKS-2; i++)
+        __breadahead(block_bdev(sb, blk_offset(i)), blk_offset(i), sb->s_blocksize);
+}
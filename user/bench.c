@@ -0,0 +1,343 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "user_header.h"
+
+/*
+    Benchmark delle operazioni put/get: system call (slot della sys_call_table) a confronto con le ioctl del
+    device a caratteri, singole e a batch, e con gli anelli di sottomissione condivisi. Ogni round riempie tutti i blocchi dati liberi e poi li invalida con
+    IOCTL_INVALIDATE_BULK (tempo escluso dalle misure). Al termine dei round il device viene riempito un'ultima volta
+    e viene misurato il throughput della lettura sequenziale di the-file tramite read(), con buffer piccoli e grandi;
+    il percorso misurato dipende dalle opzioni del montaggio (riportate insieme ai risultati): con render_cache=0 la
+    read scorre la catena dei blocchi, con o senza la pagina di staging a seconda di read_stage. make bench esegue il
+    programma su entrambi i percorsi (con un'immagine grande, ad esempio make NBLOCKS=1026 all create-fs).
+    Utilizzo: ./bench [round] [device]
+*/
+
+#define DEFAULT_ROUNDS 1000
+#define MSG "messaggio di prova del benchmark"
+#define CAPACITY (NBLOCKS-2)
+#define RING_ENTRIES 64
+#define NMODES 4
+#define NREADS 2
+
+struct bench {
+    const char *name;
+    double ns;
+    unsigned long ops;
+};
+
+static int fd;
+static int blocks[CAPACITY];
+static char destination[CAPACITY][DEFAULT_BLOCK_SIZE];
+
+static struct ring_header *ring_hdr;
+static struct ring_sqe *ring_sqes;
+static struct ring_cqe *ring_cqes;
+static char *ring_sq_data;
+static char *ring_cq_data;
+
+static double now_ns(void) {
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int ring_init(void) {
+
+    char *mem;
+    struct ring_setup_args args = { .entries = RING_ENTRIES };
+
+    if (ioctl(fd, IOCTL_RING_SETUP, &args) < 0)
+        return -1;
+    mem = mmap(NULL, args.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED)
+        return -1;
+
+    ring_hdr = (struct ring_header *) mem;
+    ring_sqes = (struct ring_sqe *) (mem + args.sqes_off);
+    ring_cqes = (struct ring_cqe *) (mem + args.cqes_off);
+    ring_sq_data = mem + args.sq_data_off;
+    ring_cq_data = mem + args.cq_data_off;
+    return 0;
+}
+
+// accoda e pubblica una voce di sottomissione (consumata dal doorbell di ring_submit())
+static void ring_queue(unsigned int op, int block, const char *msg, unsigned long long user_data) {
+
+    unsigned int idx = ring_hdr->sq_tail & (RING_ENTRIES - 1);
+
+    ring_sqes[idx].op = op;
+    ring_sqes[idx].block = block;
+    ring_sqes[idx].len = msg ? strlen(msg) : 0;
+    ring_sqes[idx].user_data = user_data;
+    if (msg)
+        memcpy(ring_sq_data + idx * RING_SLOT_SIZE, msg, strlen(msg));
+    __atomic_store_n(&(ring_hdr->sq_tail), ring_hdr->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+// suona il doorbell e consuma i completamenti (res indicizzato per user_data)
+static int ring_submit(int *res) {
+
+    int n = 0;
+    unsigned int head;
+
+    if (ioctl(fd, IOCTL_RING_ENTER) < 0)
+        return -1;
+
+    head = ring_hdr->cq_head;
+    while (head != __atomic_load_n(&(ring_hdr->cq_tail), __ATOMIC_ACQUIRE)) {
+        res[ring_cqes[head & (RING_ENTRIES - 1)].user_data] = ring_cqes[head & (RING_ENTRIES - 1)].res;
+        head++;
+        n++;
+    }
+    __atomic_store_n(&(ring_hdr->cq_head), head, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+static int invalidate_all(void) {
+
+    struct invalidate_args args = { .by = INVALIDATE_ALL };
+
+    return ioctl(fd, IOCTL_INVALIDATE_BULK, &args);
+}
+
+// opzioni render_cache e read_stage del montaggio di singlefilefs riportate in /proc/mounts (-1 se assenti)
+static void mount_options(int *render_cache, int *read_stage) {
+
+    char line[1024];
+    char *opt;
+    FILE *mounts = fopen("/proc/mounts", "r");
+
+    *render_cache = -1;
+    *read_stage = -1;
+    if (mounts == NULL)
+        return;
+
+    while (fgets(line, sizeof(line), mounts) != NULL) {
+        if (strstr(line, " singlefilefs ") == NULL)
+            continue;
+        if ((opt = strstr(line, "render_cache=")) != NULL)
+            *render_cache = atoi(opt + strlen("render_cache="));
+        if ((opt = strstr(line, "read_stage=")) != NULL)
+            *read_stage = atoi(opt + strlen("read_stage="));
+        break;
+    }
+    fclose(mounts);
+}
+
+// legge the-file dall'inizio tramite read() con buffer da buf_size byte, restituisce i byte letti
+static long read_file(const char *dev, size_t buf_size, struct bench *b) {
+
+    int rfd;
+    long total = 0;
+    ssize_t ret;
+    double start;
+    char *buf = malloc(buf_size);
+
+    rfd = open(dev, O_RDONLY);
+    if (buf == NULL || rfd < 0) {
+        free(buf);
+        return -1;
+    }
+
+    start = now_ns();
+    while ((ret = read(rfd, buf, buf_size)) > 0)
+        total += ret;
+    b->ns += now_ns() - start;
+    b->ops += total;
+
+    close(rfd);
+    free(buf);
+    return ret < 0 ? -1 : total;
+}
+
+// riempie i blocchi liberi con la modalità indicata, restituisce il numero di messaggi inseriti
+static int fill(int mode, struct bench *b) {
+
+    int i, j;
+    int n = 0;
+    double start;
+    struct put_data_args put_args;
+    struct put_batch_entry entries[CAPACITY];
+    struct batch_args batch = { .entries = entries, .nr = CAPACITY };
+
+    start = now_ns();
+    if (mode == 3) {
+        // sottomissioni a gruppi di RING_ENTRIES voci, la capienza dell'anello
+        for (i = 0; i < CAPACITY; i = j) {
+            for (j = i; j < CAPACITY && j < i + RING_ENTRIES; j++)
+                ring_queue(RING_OP_PUT, 0, MSG, j);
+            if (ring_submit(blocks) != j - i)
+                break;
+            while (n < j && blocks[n] >= 0)
+                n++;
+            if (n < j)
+                break;
+        }
+    }
+    else if (mode == 2) {
+        for (i = 0; i < CAPACITY; i++) {
+            entries[i].source = MSG;
+            entries[i].size = strlen(MSG);
+        }
+        if (ioctl(fd, IOCTL_PUT_BATCH, &batch) == 0 || batch.done > 0) {
+            for (n = 0; n < (int) batch.done; n++)
+                blocks[n] = entries[n].block;
+        }
+    }
+    else {
+        for (i = 0; i < CAPACITY; i++) {
+            if (mode == 0) {
+                blocks[n] = syscall(PUT_DATA, MSG, strlen(MSG));
+            }
+            else {
+                put_args.source = MSG;
+                put_args.size = strlen(MSG);
+                blocks[n] = ioctl(fd, IOCTL_PUT_DATA, &put_args) == 0 ? put_args.block : -1;
+            }
+            if (blocks[n] < 0)
+                break;
+            n++;
+        }
+    }
+    b->ns += now_ns() - start;
+    b->ops += n;
+
+    return n;
+}
+
+// legge i messaggi dei blocchi riempiti con la modalità indicata
+static void read_all(int mode, int n, struct bench *b) {
+
+    int i, j;
+    int res[CAPACITY];
+    double start;
+    struct get_data_args get_args;
+    struct get_batch_entry entries[CAPACITY];
+    struct batch_args batch = { .entries = entries, .nr = n };
+
+    start = now_ns();
+    if (mode == 3) {
+        for (i = 0; i < n; i = j) {
+            for (j = i; j < n && j < i + RING_ENTRIES; j++)
+                ring_queue(RING_OP_GET, blocks[j], NULL, j);
+            ring_submit(res);
+        }
+    }
+    else if (mode == 2) {
+        for (i = 0; i < n; i++) {
+            entries[i].block = blocks[i];
+            entries[i].destination = destination[i];
+            entries[i].size = DEFAULT_BLOCK_SIZE;
+        }
+        ioctl(fd, IOCTL_GET_BATCH, &batch);
+    }
+    else {
+        for (i = 0; i < n; i++) {
+            if (mode == 0) {
+                syscall(GET_DATA, blocks[i], destination[i], DEFAULT_BLOCK_SIZE);
+            }
+            else {
+                get_args.block = blocks[i];
+                get_args.destination = destination[i];
+                get_args.size = DEFAULT_BLOCK_SIZE;
+                ioctl(fd, IOCTL_GET_DATA, &get_args);
+            }
+        }
+    }
+    b->ns += now_ns() - start;
+    b->ops += n;
+}
+
+int main(int argc, char **argv) {
+
+    int i, mode, n, r;
+    int render_cache, read_stage;
+    int rounds = DEFAULT_ROUNDS;
+    const char *dev = DEV_FILE;
+    struct bench put[NMODES] = { {"put syscall"}, {"put ioctl"}, {"put ioctl batch"}, {"put ring"} };
+    struct bench get[NMODES] = { {"get syscall"}, {"get ioctl"}, {"get ioctl batch"}, {"get ring"} };
+    struct bench fill_rd = { "put read" };
+    struct bench rd[NREADS] = { {"read 4 KiB"}, {"read 64 KiB"} };
+    size_t rd_size[NREADS] = { 4096, 65536 };
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+    if (argc > 2)
+        dev = argv[2];
+
+    fd = open(dev, O_RDWR);
+    if (fd < 0) {
+        printf("[Errore]: impossibile aprire %s (%s)\n", dev, strerror(errno));
+        return -1;
+    }
+    if (ioctl(fd, IOCTL_ABI_VERSION) < BLOCKLEVEL_ABI_VERSION) {
+        printf("[Errore]: versione dell'ABI delle ioctl non supportata\n");
+        close(fd);
+        return -1;
+    }
+    if (ring_init() < 0) {
+        printf("[Errore]: impossibile allocare gli anelli di sottomissione (%s)\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if (invalidate_all() < 0) {
+        printf("[Errore]: impossibile svuotare il device (%s)\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    for (i = 0; i < rounds; i++) {
+        for (mode = 0; mode < NMODES; mode++) {
+            n = fill(mode, &put[mode]);
+            read_all(mode, n, &get[mode]);
+            if (n == 0 || invalidate_all() < 0) {
+                printf("[Errore]: round %d interrotto (%s)\n", i, strerror(errno));
+                close(fd);
+                return -1;
+            }
+        }
+    }
+
+    // lettura sequenziale del device pieno, ripetuta per ogni round
+    n = fill(2, &fill_rd);
+    for (r = 0; r < NREADS; r++) {
+        for (i = 0; i < rounds; i++) {
+            if (read_file(dev, rd_size[r], &rd[r]) < 0) {
+                printf("[Errore]: lettura di %s non riuscita (%s)\n", dev, strerror(errno));
+                close(fd);
+                return -1;
+            }
+        }
+    }
+    if (n == 0 || invalidate_all() < 0) {
+        printf("[Errore]: lettura di %s interrotta (%s)\n", dev, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    mount_options(&render_cache, &read_stage);
+
+    printf("%d round da %d messaggi\n", rounds, CAPACITY);
+    for (mode = 0; mode < NMODES; mode++)
+        printf("%-16s %10.0f ns/op %12.0f op/s\n", put[mode].name, put[mode].ns / put[mode].ops, put[mode].ops * 1e9 / put[mode].ns);
+    for (mode = 0; mode < NMODES; mode++)
+        printf("%-16s %10.0f ns/op %12.0f op/s\n", get[mode].name, get[mode].ns / get[mode].ops, get[mode].ops * 1e9 / get[mode].ns);
+    printf("read di %d messaggi: render_cache=%d, staging %s\n", n, render_cache, read_stage == 1 ? "attivo" : read_stage == 0 ? "disattivato" : "sconosciuto");
+    if (render_cache != 0)
+        printf("[Attenzione]: con render_cache diverso da 0 le read sono servite dalla copia renderizzata (make bench monta con render_cache=0)\n");
+    for (r = 0; r < NREADS; r++)
+        printf("%-16s %10.1f MB/s\n", rd[r].name, rd[r].ops * 1e3 / rd[r].ns);
+
+    close(fd);
+    return 0;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -5,13 +6,31 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <pthread.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
 #include "user_header.h"
 
-#define NTHREADS 16
+#define NCASES 17
+#define NTHREADS (2 * NCASES)   // ogni caso viene eseguito da due thread concorrenti
 #define DEFAULT_BUFFER_SIZE 128
+#define FOLLOW_TIMEOUT 1000     // ms
 
 pthread_barrier_t barrier;
+int failures;
+
+// confronto tra l'esito ottenuto e quello atteso (tenendo conto delle operazioni concorrenti degli altri thread)
+void check(pthread_t tid, const char *test, int ok) {
+
+    if (ok)
+        return;
+
+    __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+    printf("[THREAD %ld]: %s() - esito diverso da quello atteso (errno %d)\n", tid, test, errno);
+    fflush(stdout);
+}
 
 void *test_put_syscall(void *arg) {
 
@@ -39,6 +58,8 @@ void *test_put_syscall(void *arg) {
         printf("[THREAD %ld]: esecuzione test_put_syscall() fallita\n", tid);
         fflush(stdout);
     }
+    // un blocco dati oppure device pieno
+    check(tid, "test_put_syscall", (ret >= 0 && ret < NBLOCKS-2) || (ret < 0 && errno == ENOMEM));
 
     pthread_exit(NULL);
 }
@@ -59,7 +80,7 @@ void *test_get_syscall(void *arg) {
 
     pthread_barrier_wait(&barrier);
 
-    ret = syscall(GET_DATA, offset, destination, DEFAULT_BUFFER_SIZE);
+    ret = syscall(GET_DATA, offset, destination, DEFAULT_BUFFER_SIZE - 1);
     
     if(ret >= 0) {
         printf("[THREAD %ld]: esecuzione test_get_syscall() terminata con successo sul blocco %d - read: %s\n", tid, offset, destination);
@@ -69,6 +90,11 @@ void *test_get_syscall(void *arg) {
         printf("[THREAD %ld]: esecuzione test_get_syscall() fallita\n", tid);
         fflush(stdout);
     }
+    // il messaggio (terminato dopo i byte restituiti), un blocco non valido oppure un offset fuori dai blocchi dati
+    if (offset >= NBLOCKS-2)
+        check(tid, "test_get_syscall", ret < 0 && errno == EINVAL);
+    else
+        check(tid, "test_get_syscall", (ret >= 0 && ret == (int) strlen(destination)) || (ret < 0 && errno == ENODATA));
 
     pthread_exit(NULL);
 }
@@ -89,34 +115,730 @@ void *test_invalidate_syscall(void *arg) {
     ret = syscall(INVALIDATE_DATA, offset);
     
     if(ret >= 0) {
-        printf("[THREAD %ld]: esecuzione test_invalidate_syscall() terminata con successo e invalidato il blocco %d\n", tid, ret);
+        printf("[THREAD %ld]: esecuzione test_invalidate_syscall() terminata con successo e invalidato il blocco %d\n", tid, offset);
         fflush(stdout);
     }
     else {
         printf("[THREAD %ld]: esecuzione test_invalidate_syscall() fallita\n", tid);
         fflush(stdout);
     }
+    if (offset >= NBLOCKS-2)
+        check(tid, "test_invalidate_syscall", ret < 0 && errno == EINVAL);
+    else
+        check(tid, "test_invalidate_syscall", ret == 0 || (ret < 0 && errno == ENODATA));
+
+    pthread_exit(NULL);
+}
+
+void *test_put_async_ioctl(void *arg) {
+
+    int fd, ret;
+    char source[DEFAULT_BUFFER_SIZE];
+    pthread_t tid;
+    struct put_data_args args;
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_put_async_ioctl()\n", tid);
+    fflush(stdout);
+
+    sprintf(source, "Ha scritto (async) il thread %ld\n", tid);
+    args.source = source;
+    args.size = strlen(source);
+
+    fd = open(THE_FILE, O_RDWR);
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0) {
+        printf("[THREAD %ld]: esecuzione test_put_async_ioctl() fallita, impossibile aprire %s\n", tid, THE_FILE);
+        fflush(stdout);
+        check(tid, "test_put_async_ioctl", 0);
+        pthread_exit(NULL);
+    }
+
+    ret = ioctl(fd, IOCTL_PUT_DATA_ASYNC, &args);
+    if (ret == 0)
+        ret = ioctl(fd, IOCTL_BARRIER, &args.seq);   // attesa della persistenza del messaggio
+
+    if(ret == 0) {
+        printf("[THREAD %ld]: esecuzione test_put_async_ioctl() terminata con successo, blocco %d persistente (seq %llu)\n", tid, args.block, args.seq);
+        fflush(stdout);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_put_async_ioctl() fallita\n", tid);
+        fflush(stdout);
+    }
+    // blocco dati e sequenza dell'operazione resa persistente dalla barriera, oppure device pieno
+    check(tid, "test_put_async_ioctl", (ret == 0 && args.block >= 0 && args.block < NBLOCKS-2 && args.seq > 0) || (ret < 0 && errno == ENOMEM));
+
+    close(fd);
+    pthread_exit(NULL);
+}
+
+void *test_follow_read(void *arg) {
+
+    int fd, ret, follow = 1;
+    char destination[DEFAULT_BUFFER_SIZE];
+    pthread_t tid;
+    struct pollfd pfd;
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_follow_read()\n", tid);
+    fflush(stdout);
+
+    fd = open(THE_FILE, O_RDONLY);
+    if (fd >= 0) {
+        // consumo dei messaggi già presenti, poi attesa dei nuovi
+        ioctl(fd, IOCTL_FOLLOW, &follow);
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        while (read(fd, destination, sizeof(destination)) > 0);
+    }
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0) {
+        printf("[THREAD %ld]: esecuzione test_follow_read() fallita, impossibile aprire %s\n", tid, THE_FILE);
+        fflush(stdout);
+        check(tid, "test_follow_read", 0);
+        pthread_exit(NULL);
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    ret = poll(&pfd, 1, FOLLOW_TIMEOUT);
+    if (ret > 0)
+        ret = read(fd, destination, sizeof(destination) - 1);
+
+    if (ret > 0) {
+        destination[ret] = '\0';
+        printf("[THREAD %ld]: esecuzione test_follow_read() terminata con successo - nuovi messaggi: %s\n", tid, destination);
+        fflush(stdout);
+    }
+    else if (ret == 0) {
+        printf("[THREAD %ld]: esecuzione test_follow_read() terminata, nessun nuovo messaggio entro %d ms\n", tid, FOLLOW_TIMEOUT);
+        fflush(stdout);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_follow_read() fallita\n", tid);
+        fflush(stdout);
+    }
+    // nuovi messaggi, nessun messaggio entro il timeout oppure messaggi invalidati tra la poll e la read (O_NONBLOCK)
+    check(tid, "test_follow_read", ret >= 0 || errno == EAGAIN);
+
+    close(fd);
+    pthread_exit(NULL);
+}
+
+void *test_notify_fd(void *arg) {
+
+    int fd, nfd, ret, i;
+    struct blocklevel_event events[NTHREADS];
+    pthread_t tid;
+    struct pollfd pfd;
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_notify_fd()\n", tid);
+    fflush(stdout);
+
+    nfd = -1;
+    fd = open(THE_FILE, O_RDONLY);
+    if (fd >= 0)
+        nfd = ioctl(fd, IOCTL_NOTIFY_FD);
+
+    pthread_barrier_wait(&barrier);
+
+    if (nfd < 0) {
+        printf("[THREAD %ld]: esecuzione test_notify_fd() fallita, impossibile ottenere il file descriptor di notifica\n", tid);
+        fflush(stdout);
+        check(tid, "test_notify_fd", 0);
+        if (fd >= 0) close(fd);
+        pthread_exit(NULL);
+    }
+
+    pfd.fd = nfd;
+    pfd.events = POLLIN;
+    ret = poll(&pfd, 1, FOLLOW_TIMEOUT);
+    if (ret > 0)
+        ret = read(nfd, events, sizeof(events));
+
+    if (ret >= 0) {
+        printf("[THREAD %ld]: esecuzione test_notify_fd() terminata con successo - %ld eventi\n", tid, ret / (long)sizeof(struct blocklevel_event));
+        for (i = 0; i < ret / (int)sizeof(struct blocklevel_event); i++)
+            printf("[THREAD %ld]:     op %u, blocco %u, seq %llu\n", tid, events[i].op, events[i].block, events[i].seq);
+        fflush(stdout);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_notify_fd() fallita\n", tid);
+        fflush(stdout);
+    }
+    // solo eventi interi, di tipo noto e su blocchi dati
+    check(tid, "test_notify_fd", ret >= 0 && ret % sizeof(struct blocklevel_event) == 0);
+    for (i = 0; ret > 0 && i < ret / (int)sizeof(struct blocklevel_event); i++)
+        check(tid, "test_notify_fd", events[i].op >= NOTIFY_PUT && events[i].op <= NOTIFY_APPEND && (events[i].op == NOTIFY_OVERFLOW || events[i].block < NBLOCKS-2));
+
+    close(nfd);
+    close(fd);
+    pthread_exit(NULL);
+}
+
+void *test_cursor_fetch(void *arg) {
+
+    int fd, ret;
+    unsigned int i;
+    char buf[DEFAULT_BUFFER_SIZE * 4];
+    char *p;
+    unsigned long long seq;
+    pthread_t tid;
+    struct cursor_msg *msg;
+    struct cursor_args cursor = { .whence = CURSOR_HEAD };
+    struct cursor_fetch_args fetch = { .buf = buf, .size = sizeof(buf), .max = 4 };
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_cursor_fetch()\n", tid);
+    fflush(stdout);
+
+    fd = open(THE_FILE, O_RDONLY);
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0) {
+        printf("[THREAD %ld]: esecuzione test_cursor_fetch() fallita, impossibile aprire %s\n", tid, THE_FILE);
+        fflush(stdout);
+        check(tid, "test_cursor_fetch", 0);
+        pthread_exit(NULL);
+    }
+
+    ret = ioctl(fd, IOCTL_CURSOR_OPEN, &cursor);
+    if (ret == 0)
+        ret = ioctl(fd, IOCTL_CURSOR_FETCH, &fetch);
+
+    if (ret == 0) {
+        printf("[THREAD %ld]: esecuzione test_cursor_fetch() terminata con successo - %u messaggi (cursore su seq %llu)\n", tid, fetch.count, fetch.seq);
+        for (i = 0, p = buf, seq = 0; i < fetch.count; i++, p += CURSOR_MSG_SIZE(msg->len)) {
+            msg = (struct cursor_msg *)p;
+            printf("[THREAD %ld]:     seq %llu (ts %lld), blocco %u: %.*s\n", tid, msg->seq, msg->timestamp, msg->block, (int)msg->len, p + sizeof(struct cursor_msg));
+            // messaggi in ordine di sequenza, su blocchi dati e contenuti nel buffer
+            check(tid, "test_cursor_fetch", msg->seq > seq && msg->block < NBLOCKS-2 && p + CURSOR_MSG_SIZE(msg->len) <= buf + sizeof(buf));
+            seq = msg->seq;
+        }
+        fflush(stdout);
+        check(tid, "test_cursor_fetch", fetch.count <= fetch.max && fetch.seq == seq);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_cursor_fetch() fallita\n", tid);
+        fflush(stdout);
+        check(tid, "test_cursor_fetch", 0);
+    }
+
+    close(fd);
+    pthread_exit(NULL);
+}
+
+void *test_invalidate_bulk_ioctl(void *arg) {
+
+    int fd, ret;
+    int offsets[2];
+    pthread_t tid;
+    struct invalidate_args args = { .by = INVALIDATE_LIST, .offsets = offsets, .nr = 2 };
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_invalidate_bulk_ioctl()\n", tid);
+    fflush(stdout);
+
+    offsets[0] = (int)(tid % (NBLOCKS-2));
+    offsets[1] = (int)((tid / NBLOCKS) % (NBLOCKS-2));
+
+    fd = open(THE_FILE, O_RDWR);
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0) {
+        printf("[THREAD %ld]: esecuzione test_invalidate_bulk_ioctl() fallita, impossibile aprire %s\n", tid, THE_FILE);
+        fflush(stdout);
+        check(tid, "test_invalidate_bulk_ioctl", 0);
+        pthread_exit(NULL);
+    }
+
+    ret = ioctl(fd, IOCTL_INVALIDATE_BULK, &args);
+
+    if (ret == 0) {
+        printf("[THREAD %ld]: esecuzione test_invalidate_bulk_ioctl() terminata con successo, invalidati %u messaggi tra i blocchi %d e %d\n", tid, args.count, offsets[0], offsets[1]);
+        fflush(stdout);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_invalidate_bulk_ioctl() fallita\n", tid);
+        fflush(stdout);
+    }
+    // al più i messaggi indicati (quelli già invalidi vengono saltati)
+    check(tid, "test_invalidate_bulk_ioctl", ret == 0 && args.count <= (offsets[0] == offsets[1] ? 1 : 2));
+
+    close(fd);
+    pthread_exit(NULL);
+}
+
+
+void *test_update_ioctl(void *arg) {
+
+    int fd, ret;
+    pthread_t tid;
+    char msg[64];
+    struct update_data_args args;
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_update_ioctl()\n", tid);
+    fflush(stdout);
+
+    snprintf(msg, sizeof(msg), "messaggio aggiornato dal thread %ld", tid);
+    args.block = (int)(tid % (NBLOCKS-2));
+    args.source = msg;
+    args.size = strlen(msg);
+
+    fd = open(THE_FILE, O_RDWR);
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0) {
+        printf("[THREAD %ld]: esecuzione test_update_ioctl() fallita, impossibile aprire %s\n", tid, THE_FILE);
+        fflush(stdout);
+        check(tid, "test_update_ioctl", 0);
+        pthread_exit(NULL);
+    }
+
+    ret = ioctl(fd, IOCTL_UPDATE_DATA, &args);
+
+    if (ret >= 0) {
+        printf("[THREAD %ld]: esecuzione test_update_ioctl() terminata con successo, blocco %d aggiornato (%d bytes)\n", tid, args.block, ret);
+        fflush(stdout);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_update_ioctl() fallita sul blocco %d\n", tid, args.block);
+        fflush(stdout);
+    }
+    // l'intero messaggio nuovo oppure un blocco non valido
+    check(tid, "test_update_ioctl", ret == (int) strlen(msg) || (ret < 0 && errno == ENODATA));
 
+    close(fd);
     pthread_exit(NULL);
 }
 
 
+void *test_append_ioctl(void *arg) {
+
+    int fd, ret;
+    pthread_t tid;
+    char msg[64];
+    struct update_data_args args;
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_append_ioctl()\n", tid);
+    fflush(stdout);
+
+    snprintf(msg, sizeof(msg), " - campo accodato dal thread %ld", tid);
+    args.block = (int)(tid % (NBLOCKS-2));
+    args.source = msg;
+    args.size = strlen(msg);
+
+    fd = open(THE_FILE, O_RDWR);
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0) {
+        printf("[THREAD %ld]: esecuzione test_append_ioctl() fallita, impossibile aprire %s\n", tid, THE_FILE);
+        fflush(stdout);
+        check(tid, "test_append_ioctl", 0);
+        pthread_exit(NULL);
+    }
+
+    ret = ioctl(fd, IOCTL_APPEND_DATA, &args);
+
+    if (ret >= 0) {
+        printf("[THREAD %ld]: esecuzione test_append_ioctl() terminata con successo, accodati %d bytes al blocco %d\n", tid, ret, args.block);
+        fflush(stdout);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_append_ioctl() fallita sul blocco %d\n", tid, args.block);
+        fflush(stdout);
+    }
+    // tutti i byte accodati, un blocco non valido oppure nessun blocco libero per la continuazione
+    check(tid, "test_append_ioctl", ret == (int) strlen(msg) || (ret < 0 && (errno == ENODATA || errno == ENOMEM)));
+
+    close(fd);
+    pthread_exit(NULL);
+}
+
+
+void *test_channel_put(void *arg) {
+
+    int fd, ret;
+    pthread_t tid;
+    char msg[64];
+    struct put_data_args args;
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_channel_put()\n", tid);
+    fflush(stdout);
+
+    snprintf(msg, sizeof(msg), "messaggio sul canale 1 dal thread %ld", tid);
+    args.source = msg;
+    args.size = strlen(msg);
+
+    fd = open(CHANNEL_FILE, O_RDWR);
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0) {
+        printf("[THREAD %ld]: esecuzione test_channel_put() fallita, impossibile aprire %s\n", tid, CHANNEL_FILE);
+        fflush(stdout);
+        check(tid, "test_channel_put", 0);
+        pthread_exit(NULL);
+    }
+
+    ret = ioctl(fd, IOCTL_PUT_DATA, &args);
+
+    if (ret == 0) {
+        printf("[THREAD %ld]: esecuzione test_channel_put() terminata con successo, messaggio scritto nel blocco %d (seq %llu)\n", tid, args.block, args.seq);
+        fflush(stdout);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_channel_put() fallita\n", tid);
+        fflush(stdout);
+    }
+    check(tid, "test_channel_put", (ret == 0 && args.block >= 0 && args.block < NBLOCKS-2 && args.seq > 0) || (ret < 0 && errno == ENOMEM));
+
+    close(fd);
+    pthread_exit(NULL);
+}
+
+void *test_get_ioctl(void *arg) {
+
+    int fd, ret;
+    pthread_t tid;
+    char buffer[DEFAULT_BUFFER_SIZE];
+    struct get_data_args args;
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_get_ioctl()\n", tid);
+    fflush(stdout);
+
+    args.block = (int)(tid % (NBLOCKS-2));
+    args.destination = buffer;
+    args.size = DEFAULT_BUFFER_SIZE - 1;
+
+    fd = open(THE_FILE, O_RDONLY);
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0) {
+        printf("[THREAD %ld]: esecuzione test_get_ioctl() fallita, impossibile aprire %s\n", tid, THE_FILE);
+        fflush(stdout);
+        check(tid, "test_get_ioctl", 0);
+        pthread_exit(NULL);
+    }
+
+    ret = ioctl(fd, IOCTL_GET_DATA, &args);
+
+    if (ret >= 0) {
+        printf("[THREAD %ld]: esecuzione test_get_ioctl() terminata con successo, letti %d bytes dal blocco %d del montaggio di %s\n", tid, ret, args.block, THE_FILE);
+        fflush(stdout);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_get_ioctl() fallita sul blocco %d\n", tid, args.block);
+        fflush(stdout);
+    }
+    check(tid, "test_get_ioctl", (ret >= 0 && ret == (int) strlen(buffer)) || (ret < 0 && errno == ENODATA));
+
+    close(fd);
+    pthread_exit(NULL);
+}
+
+void *test_put_batch_dev(void *arg) {
+
+    int fd, ret, i;
+    pthread_t tid;
+    char source[2][DEFAULT_BUFFER_SIZE];
+    struct put_batch_entry entries[2];
+    struct batch_args args;
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_put_batch_dev()\n", tid);
+    fflush(stdout);
+
+    for (i = 0; i < 2; i++) {
+        sprintf(source[i], "Batch %d del thread %ld", i, tid);
+        entries[i].source = source[i];
+        entries[i].size = strlen(source[i]);
+    }
+    args.entries = entries;
+    args.nr = 2;
+
+    fd = open(DEV_FILE, O_RDWR);
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0) {
+        printf("[THREAD %ld]: esecuzione test_put_batch_dev() fallita, impossibile aprire %s\n", tid, DEV_FILE);
+        fflush(stdout);
+        check(tid, "test_put_batch_dev", 0);
+        pthread_exit(NULL);
+    }
+
+    ret = ioctl(fd, IOCTL_PUT_BATCH, &args);
+
+    if (ret >= 0) {
+        printf("[THREAD %ld]: esecuzione test_put_batch_dev() terminata con successo, scritti %u messaggi (sequenza %llu)\n", tid, args.done, args.seq);
+        fflush(stdout);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_put_batch_dev() fallita\n", tid);
+        fflush(stdout);
+    }
+    // entrambi i messaggi, oppure device pieno prima della fine del batch
+    check(tid, "test_put_batch_dev", (ret >= 0 && args.done == 2) || (ret < 0 && errno == ENOMEM && args.done < 2));
+
+    close(fd);
+    pthread_exit(NULL);
+}
+
+void *test_ring_dev(void *arg) {
+
+    int fd, ret;
+    unsigned int head;
+    pthread_t tid;
+    char *mem;
+    struct ring_setup_args args;
+    struct ring_header *hdr;
+    struct ring_sqe *sqe;
+    struct ring_cqe *cqe;
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_ring_dev()\n", tid);
+    fflush(stdout);
+
+    fd = open(DEV_FILE, O_RDWR);
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0) {
+        printf("[THREAD %ld]: esecuzione test_ring_dev() fallita, impossibile aprire %s\n", tid, DEV_FILE);
+        fflush(stdout);
+        check(tid, "test_ring_dev", 0);
+        pthread_exit(NULL);
+    }
+
+    args.entries = 4;
+    mem = MAP_FAILED;
+    if (ioctl(fd, IOCTL_RING_SETUP, &args) == 0)
+        mem = mmap(NULL, args.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        printf("[THREAD %ld]: esecuzione test_ring_dev() fallita, impossibile mappare gli anelli\n", tid);
+        fflush(stdout);
+        check(tid, "test_ring_dev", 0);
+        close(fd);
+        pthread_exit(NULL);
+    }
+    hdr = (struct ring_header *) mem;
+
+    // una put e una get del blocco 0 con un solo doorbell
+    sqe = (struct ring_sqe *) (mem + args.sqes_off);
+    sprintf(mem + args.sq_data_off, "Ring del thread %ld", tid);
+    sqe[0].op = RING_OP_PUT;
+    sqe[0].len = strlen(mem + args.sq_data_off);
+    sqe[0].user_data = 0;
+    sqe[1].op = RING_OP_GET;
+    sqe[1].block = 0;
+    sqe[1].user_data = 1;
+    __atomic_store_n(&(hdr->sq_tail), 2, __ATOMIC_RELEASE);
+
+    ret = ioctl(fd, IOCTL_RING_ENTER);
+
+    if (ret >= 0) {
+        cqe = (struct ring_cqe *) (mem + args.cqes_off);
+        for (head = 0; head != __atomic_load_n(&(hdr->cq_tail), __ATOMIC_ACQUIRE); head++) {
+            printf("[THREAD %ld]: test_ring_dev() completamento %llu: res %d\n", tid, cqe[head].user_data, cqe[head].res);
+            fflush(stdout);
+        }
+        printf("[THREAD %ld]: esecuzione test_ring_dev() terminata con successo, consumate %d voci\n", tid, ret);
+        fflush(stdout);
+        // due completamenti nell'ordine delle sottomissioni: la put scrive un blocco dati (o trova il device pieno),
+        // la get restituisce il messaggio del blocco 0 (o trova il blocco non valido)
+        check(tid, "test_ring_dev", ret == 2 && head == 2 && cqe[0].user_data == 0 && cqe[1].user_data == 1);
+        check(tid, "test_ring_dev", (cqe[0].res >= 0 && cqe[0].res < NBLOCKS-2) || cqe[0].res == -ENOMEM);
+        check(tid, "test_ring_dev", (cqe[1].res >= 0 && cqe[1].res == (int) strlen(mem + args.cq_data_off + RING_SLOT_SIZE)) || cqe[1].res == -ENODATA);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_ring_dev() fallita\n", tid);
+        fflush(stdout);
+        check(tid, "test_ring_dev", 0);
+    }
+
+    munmap(mem, args.size);
+    close(fd);
+    pthread_exit(NULL);
+}
+
+void *test_mmap_snapshot(void *arg) {
+
+    int fd;
+    unsigned int i;
+    size_t size;
+    pthread_t tid;
+    char *mem;
+    struct snapshot_header *hdr;
+    struct snapshot_entry *entry;
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_mmap_snapshot()\n", tid);
+    fflush(stdout);
+
+    fd = open(THE_FILE, O_RDONLY);
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0) {
+        printf("[THREAD %ld]: esecuzione test_mmap_snapshot() fallita, impossibile aprire %s\n", tid, THE_FILE);
+        fflush(stdout);
+        check(tid, "test_mmap_snapshot", 0);
+        pthread_exit(NULL);
+    }
+
+    // la prima pagina contiene l'intestazione con la dimensione dell'intero snapshot
+    mem = mmap(NULL, 4096, PROT_READ, MAP_SHARED, fd, 0);
+    size = 0;
+    if (mem != MAP_FAILED) {
+        size = ((struct snapshot_header *) mem)->size;
+        munmap(mem, 4096);
+        mem = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    if (mem == MAP_FAILED) {
+        printf("[THREAD %ld]: esecuzione test_mmap_snapshot() fallita, impossibile mappare %s\n", tid, THE_FILE);
+        fflush(stdout);
+        check(tid, "test_mmap_snapshot", 0);
+        close(fd);
+        pthread_exit(NULL);
+    }
+
+    hdr = (struct snapshot_header *) mem;
+    entry = (struct snapshot_entry *) (mem + sizeof(struct snapshot_header));
+    check(tid, "test_mmap_snapshot", hdr->nr <= NBLOCKS-2 && hdr->size == size);
+    for (i = 0; i < hdr->nr; i++) {
+        // le copie dei blocchi sono prese insieme alla tabella: la sequenza nell'intestazione del blocco coincide
+        check(tid, "test_mmap_snapshot", entry[i].block < NBLOCKS-2 && entry[i].seq <= hdr->seq);
+        if (entry[i].block >= NBLOCKS-2 || *(unsigned long long *) (mem + hdr->data_off + entry[i].block * 4096 + SNAPSHOT_BLOCK_SEQ_OFF) != entry[i].seq) {
+            check(tid, "test_mmap_snapshot", 0);
+            continue;
+        }
+        printf("[THREAD %ld]: test_mmap_snapshot() blocco %u, seq %llu: '%.*s'\n", tid, entry[i].block, entry[i].seq, (int) entry[i].len, mem + entry[i].offset);
+        fflush(stdout);
+    }
+    printf("[THREAD %ld]: esecuzione test_mmap_snapshot() terminata con successo, %u voci nella tabella\n", tid, hdr->nr);
+    fflush(stdout);
+
+    munmap(mem, size);
+    close(fd);
+    pthread_exit(NULL);
+}
+
+void *test_splice(void *arg) {
+
+    int fd, ret, n;
+    int p[2];
+    pthread_t tid;
+    char buffer[DEFAULT_BUFFER_SIZE];
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_splice()\n", tid);
+    fflush(stdout);
+
+    fd = open(THE_FILE, O_RDONLY);
+
+    pthread_barrier_wait(&barrier);
+
+    if (fd < 0 || pipe(p) < 0) {
+        printf("[THREAD %ld]: esecuzione test_splice() fallita, impossibile aprire %s o creare la pipe\n", tid, THE_FILE);
+        fflush(stdout);
+        check(tid, "test_splice", 0);
+        if (fd >= 0)
+            close(fd);
+        pthread_exit(NULL);
+    }
+
+    // il contenuto di the-file passa nella pipe senza attraversare lo spazio utente
+    ret = splice(fd, NULL, p[1], NULL, DEFAULT_BUFFER_SIZE - 1, 0);
+
+    if (ret >= 0) {
+        n = ret > 0 ? read(p[0], buffer, ret) : 0;
+        buffer[n > 0 ? n : 0] = '\0';
+        printf("[THREAD %ld]: esecuzione test_splice() terminata con successo, %d bytes nella pipe: %s\n", tid, n, buffer);
+        fflush(stdout);
+        // la pipe contiene esattamente i byte trasferiti
+        check(tid, "test_splice", n == ret);
+    }
+    else {
+        printf("[THREAD %ld]: esecuzione test_splice() fallita\n", tid);
+        fflush(stdout);
+        check(tid, "test_splice", 0);
+    }
+
+    close(p[0]);
+    close(p[1]);
+    close(fd);
+    pthread_exit(NULL);
+}
+
+void *test_stat(void *arg) {
+
+    int fd;
+    long total = 0;
+    ssize_t ret;
+    pthread_t tid;
+    struct stat st;
+    struct statvfs vfs;
+    char buffer[DEFAULT_BUFFER_SIZE];
+
+    tid = *(pthread_t *)arg;
+    printf("[THREAD %ld]: funzione test_stat()\n", tid);
+    fflush(stdout);
+
+    pthread_barrier_wait(&barrier);
+
+    // la dimensione riportata da stat corrisponde ai byte restituiti dalla lettura completa (senza scritture concorrenti)
+    fd = open(THE_FILE, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0 || statvfs(THE_FILE, &vfs) < 0) {
+        printf("[THREAD %ld]: esecuzione test_stat() fallita\n", tid);
+        fflush(stdout);
+        check(tid, "test_stat", 0);
+        if (fd >= 0)
+            close(fd);
+        pthread_exit(NULL);
+    }
+    while ((ret = read(fd, buffer, DEFAULT_BUFFER_SIZE)) > 0)
+        total += ret;
+
+    printf("[THREAD %ld]: esecuzione test_stat() terminata, st_size=%ld, letti %ld bytes, blocchi liberi %lu su %lu\n", tid, (long) st.st_size, total, (unsigned long) vfs.f_bfree, (unsigned long) vfs.f_blocks);
+    fflush(stdout);
+    // i blocchi riportati da statvfs sono quelli dati; dimensione e byte letti coincidono solo senza scritture concorrenti
+    check(tid, "test_stat", ret == 0 && vfs.f_blocks == NBLOCKS-2 && vfs.f_bfree <= vfs.f_blocks && st.st_size >= 0);
+
+    close(fd);
+    pthread_exit(NULL);
+}
+
+// casi di test, eseguiti tutti in modo deterministico (il thread i esegue il caso i % NCASES)
+void *(*tests[NCASES])(void *) = {
+    test_put_syscall, test_get_syscall, test_invalidate_syscall, test_put_async_ioctl, test_follow_read,
+    test_notify_fd, test_cursor_fetch, test_invalidate_bulk_ioctl, test_update_ioctl, test_append_ioctl,
+    test_channel_put, test_get_ioctl, test_put_batch_dev, test_ring_dev, test_mmap_snapshot, test_splice, test_stat
+};
+
 int main(int argc, char *argv[]) {
     
-    int ret, i, thread;
-    long r;
+    int ret, i;
     pthread_t tids[NTHREADS];
 
     pthread_barrier_init(&barrier, NULL, NTHREADS);
     
     for(i = 0; i < NTHREADS; i++) {
-        r = random();
-        thread = r % 3;
-        if (thread == 0) ret = pthread_create(&tids[i], NULL, test_put_syscall, &tids[i]);
-        else if (thread == 1) ret = pthread_create(&tids[i], NULL, test_get_syscall, &tids[i]);
-        else if (thread == 2) ret = pthread_create(&tids[i], NULL, test_invalidate_syscall, &tids[i]);
-        else goto error;
-
+        ret = pthread_create(&tids[i], NULL, tests[i % NCASES], &tids[i]);
         if(ret != 0) 
             goto error;
     }
@@ -126,6 +848,14 @@ int main(int argc, char *argv[]) {
     }
 
     pthread_barrier_destroy(&barrier);
+
+    if (failures > 0) {
+        printf("\n[Errore]: %d verifiche fallite\n", failures);
+        fflush(stdout);
+        return 1;
+    }
+    printf("\nTutti i %d casi di test sono stati eseguiti (%d thread) senza errori\n", NCASES, NTHREADS);
+    fflush(stdout);
     return 0;
 
 error:
@@ -133,4 +863,4 @@ error:
     fflush(stdout);
     pthread_barrier_destroy(&barrier);
     return -1;
-}
\ No newline at end of file
+}
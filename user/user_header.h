@@ -2,12 +2,17 @@
 #define _USER_HEADER_H
 
 #include "../common_header.h"
+#include "../ioctl_header.h"
 
 // SYSTEM CALLS
 #define PUT_DATA         134
 #define GET_DATA         156
 #define INVALIDATE_DATA  174
 
+#define THE_FILE "../mount/the-file"   // file del dispositivo su cui invocare le ioctl
+#define CHANNEL_FILE "../mount/channel-1"   // file del canale 1
+#define DEV_FILE "/dev/blockleveldev"   // device a caratteri del modulo (make create-dev)
+
 #define flush(stdin) while(getchar() != '\n') // pulizia del buffer stdin
 
 // MENU UTENTE
@@ -1,19 +1,27 @@
+#include <linux/bitmap.h>
+#include <linux/blkdev.h>
 #include <linux/buffer_head.h>
 #include <linux/fs.h>
 #include <linux/init.h>
+#include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/seqlock.h>
 #include <linux/slab.h>
+#include <linux/timekeeping.h>
+#include <linux/uaccess.h>
+#include <linux/uio.h>
+#include <linux/xarray.h>
 
 #include "utils_header.h"
 
 // questa funzione restituisce il puntatore alla struttura dati che comprende le informazioni contenute nel superblocco del dispositivo
-struct onefilefs_sb_info *get_sb_info(struct super_block *global_sb) {
+struct onefilefs_sb_info *get_sb_info(struct super_block *sb) {
     
     struct buffer_head *bh;
     struct onefilefs_sb_info *sb_disk;
 
-    bh = sb_bread(global_sb, SB_BLOCK_NUMBER);
-    if (!(global_sb && bh)) {
+    bh = sb_bread(sb, SB_BLOCK_NUMBER);
+    if (!(sb && bh)) {
         return NULL;
     }
 
@@ -24,13 +32,13 @@ struct onefilefs_sb_info *get_sb_info(struct super_block *global_sb) {
 }   
 
 // questa funzione restituisce il puntatore alla struttura dati che comprende i metadati + dati del blocco
-struct bdev_layout* get_block(struct super_block *global_sb, unsigned int block_num) {
+struct bdev_layout* get_block(struct super_block *sb, unsigned int block_num) {
 
     struct buffer_head *bh;
     struct bdev_layout *bdev_blk;
 
-    bh = sb_bread(global_sb, block_num);
-    if (!(global_sb && bh)) {
+    bh = bread_block(sb, block_num);
+    if (!(sb && bh)) {
         return NULL;
     }
     bdev_blk = (struct bdev_layout *) bh->b_data;
@@ -39,171 +47,280 @@ struct bdev_layout* get_block(struct super_block *global_sb, unsigned int block_
     return bdev_blk;
 }
 
-// questa funzione scrive sul superblocco del dispositivo
-int set_sb_info(struct super_block *global_sb, unsigned int new_first_valid, unsigned int new_last_valid) {
+// questa funzione aggiorna testa e coda del canale chan nel superblocco del dispositivo (la modifica viene registrata nel journal)
+int set_sb_info(struct super_block *sb, unsigned int chan, unsigned int new_first_valid, unsigned int new_last_valid) {
 
-    struct buffer_head *bh;
-    struct onefilefs_sb_info *sb_disk;
-
-    bh = sb_bread(global_sb, SB_BLOCK_NUMBER);
-    if (!(global_sb && bh)) {
+    if (journal_log_sb(sb, chan, new_first_valid, new_last_valid) < 0) {
         return -1;
     }
-    sb_disk = (struct onefilefs_sb_info *) bh->b_data;
-    sb_disk->first_valid = new_first_valid;
-    sb_disk->last_valid = new_last_valid;
 
-    mark_buffer_dirty(bh);
+    return 0;
+}
 
-    // forza la scrittura in modo sincrono sul device
-    #ifdef SYNC_WRITE_BACK 
-    if(sync_dirty_buffer(bh) == 0) {
-        AUDIT printk(KERN_INFO "%s: scrittura sincrona avvenuta con successo", MODNAME);
-    }
-    else {
-        printk(KERN_CRIT "%s: scrittura sincrona fallita", MODNAME);
+// questa funzione scrive soltanto i metadati su uno specifico blocco all'interno del dispositivo (tramite journal)
+int set_block_metadata_valid(struct super_block *sb, unsigned int last_valid, unsigned int next_block_num) {
+
+    if (journal_log_block(sb, last_valid, set_valid(next_block_num)) < 0) {
+        return -1;
     }
-    #endif
 
-    brelse(bh);
+    return 0;
+}
+
+// questa funzione aggiorna i metadati di uno specifico blocco all'interno del dispositivo (tramite journal)
+int update_block_metadata(struct super_block *sb, unsigned int block_num, unsigned int next_block_num) {
+
+    if (journal_log_block(sb, block_num, set_valid(next_block_num)) < 0) {
+        return -1;
+    }
 
     return 0;
 }
 
-// questa funzione scrive soltanto i metadati su uno specifico blocco all'interno del dispositivo
-int set_block_metadata_valid(struct super_block *global_sb, unsigned int last_valid, unsigned int next_block_num) {
+// questa funzione scrive i dati di un blocco libero, che verrà reso persistente prima del commit della transazione
+int set_block_data(struct super_block *sb, unsigned int block_num, char *source, size_t size, uint64_t seq, int64_t timestamp, unsigned int flags) {
 
     struct buffer_head *bh;
     struct bdev_layout *bdev_blk;
 
-    bh = sb_bread(global_sb, last_valid);
-    if (!(global_sb && bh)) {
+    bh = bread_block(sb, block_num);
+    if (!(sb && bh)) {
         return -1;
     }
+
     bdev_blk = (struct bdev_layout *) bh->b_data;
-    bdev_blk->next_block = set_valid(next_block_num);
 
-    mark_buffer_dirty(bh);
+    bdev_blk->len = size;
+    bdev_blk->seq = seq;
+    bdev_blk->timestamp = timestamp;
+    bdev_blk->cont_block = 0;
+    bdev_blk->flags = flags;
 
-    // forza la scrittura in modo sincrono sul device
-    #ifdef SYNC_WRITE_BACK 
-    if(sync_dirty_buffer(bh) == 0) {
-        AUDIT printk(KERN_INFO "%s: scrittura sincrona avvenuta con successo", MODNAME);
-    }
-    else {
-        printk(KERN_CRIT "%s: scrittura sincrona fallita", MODNAME);
+    // i dati possono essere già stati copiati nel buffer del blocco dal chiamante (put_data)
+    if (source != bdev_blk->data)
+        memcpy(bdev_blk->data, source, size);
+    memset(bdev_blk->data + size, 0, DATA_SIZE - size);
+
+    mark_block_dirty(sb, bh);
+
+    if (journal_add_data(sb, bh) < 0) {
+        brelse(bh);
+        return -1;
     }
-    #endif
 
     brelse(bh);
 
+    // questo è l'ultimo blocco inserito e reso valido, non ha un successore
+    if (journal_log_block(sb, block_num, set_valid(-1)) < 0) {
+        return -1;
+    }
+    FS_INFO(sb)->nr_used++;
+
     return 0;
 }
 
-// questa funzione aggiorna i metadati di uno specifico blocco all'interno del dispositivo
-int update_block_metadata(struct super_block *global_sb, unsigned int block_num, unsigned int next_block_num) {
+// sostituisce il contenuto di un blocco valido mantenendone la posizione nella catena, il numero di sequenza e
+// l'istante di inserimento: dati e lunghezza vengono aggiornati sotto il seqcount del blocco (i lettori vedono il
+// messaggio interamente vecchio o interamente nuovo) e registrati nel journal con un'unica immagine del blocco;
+// gli eventuali blocchi di continuazione vengono staccati dal messaggio e restituiti in cont (da rilasciare
+// dopo il grace period)
+int update_block_data(struct super_block *sb, unsigned int block_num, char *source, size_t size, unsigned int *cont) {
 
+    int old_len;
     struct buffer_head *bh;
     struct bdev_layout *bdev_blk;
+    seqcount_mutex_t *sc = &(FS_INFO(sb)->block_sc[block_num - 2]);
 
-    bh = sb_bread(global_sb, block_num);
-    if (!(global_sb && bh)) {
+    bh = bread_block(sb, block_num);
+    if (!(sb && bh)) {
         return -1;
     }
 
     bdev_blk = (struct bdev_layout *) bh->b_data;
-    bdev_blk->next_block = set_valid(next_block_num);  
-
-    mark_buffer_dirty(bh);
+    old_len = block_data_len(bdev_blk);
+    if (old_len < 0) {
+        brelse(bh);
+        return -1;
+    }
 
-    // forza la scrittura in modo sincrono sul device
-    #ifdef SYNC_WRITE_BACK 
-    if(sync_dirty_buffer(bh) == 0) {
-        AUDIT printk(KERN_INFO "%s: scrittura sincrona avvenuta con successo", MODNAME);
+    // il contenuto precedente viene conservato per journal_abort_op()
+    if (journal_save_data(sb, bh, sc) < 0) {
+        brelse(bh);
+        return -1;
     }
-    else {
-        printk(KERN_CRIT "%s: scrittura sincrona fallita", MODNAME);
+
+    write_seqcount_begin(sc);
+    memcpy(bdev_blk->data, source, size);
+    if (old_len > size)
+        memset(bdev_blk->data + size, 0, old_len - size);
+    bdev_blk->len = size;
+    *cont = bdev_blk->cont_block;
+    bdev_blk->cont_block = 0;
+    write_seqcount_end(sc);
+
+    mark_block_dirty(sb, bh);
+
+    if (journal_add_data(sb, bh) < 0) {
+        brelse(bh);
+        return -1;
     }
-    #endif
 
     brelse(bh);
 
     return 0;
 }
 
-// questa funzione scrive soltanto
-int set_block_data(struct super_block *global_sb, unsigned int block_num, char *source, size_t size) {
+// accoda size byte al messaggio che inizia nel blocco block_num: i byte che entrano nell'ultimo blocco del messaggio
+// vengono scritti in coda ai suoi dati, i restanti in un blocco libero marcato come continuazione e agganciato
+// all'ultimo blocco; lunghezza e aggancio vengono aggiornati sotto il seqcount del primo blocco, quindi i lettori
+// vedono il messaggio interamente prima o interamente dopo l'accodamento (write_lock acquisito, size < DATA_SIZE);
+// restituisce il blocco di continuazione utilizzato oppure -1 se non è stato necessario
+int append_block_data(struct super_block *sb, unsigned int block_num, char *source, size_t size) {
 
-    int i;
+    int ret;
+    int new_block = -1;
+    int len;
+    unsigned int room;
+    unsigned int hops = 0;
+    unsigned int last_block_num = block_num;
     struct buffer_head *bh;
+    struct bdev_layout *head_blk;
     struct bdev_layout *bdev_blk;
+    seqcount_mutex_t *sc = &(FS_INFO(sb)->block_sc[block_num - 2]);
 
-    bh = sb_bread(global_sb, block_num);
-    if (!(global_sb && bh)) {
-        return -1;
+    // ultimo blocco del messaggio
+    head_blk = get_block(sb, block_num);
+    if (head_blk == NULL) {
+        return -EIO;
+    }
+    bdev_blk = head_blk;
+    while (get_validity(bdev_blk->cont_block) && get_block_num(bdev_blk->cont_block) < NBLOCKS-2 && hops++ < NBLOCKS-2) {
+        last_block_num = blk_offset(get_block_num(bdev_blk->cont_block));
+        bdev_blk = get_block(sb, last_block_num);
+        if (bdev_blk == NULL) {
+            return -EIO;
+        }
     }
 
-    bdev_blk = (struct bdev_layout *) bh->b_data;
-    bdev_blk->next_block = set_valid(-1);   // questo è l'ultimo blocco inserito e reso valido, non ha un successore
+    len = block_data_len(bdev_blk);
+    if (len < 0) {
+        return len;
+    }
+    room = min_t(size_t, DATA_SIZE - len, size);
 
-    for(i = 0; i < DATA_SIZE; i++) {
-        if (i < size)
-            bdev_blk->data[i] = source[i];
-        else
-            bdev_blk->data[i] = '\0';
+    // i byte in eccesso vanno in un nuovo blocco, scritto prima di essere agganciato (quindi non ancora visibile)
+    if (room < size) {
+        new_block = get_free_block(sb);
+        if (new_block < 0) {
+            return new_block;
+        }
+        ret = set_block_data(sb, blk_offset(new_block), source + room, size - room, head_blk->seq, head_blk->timestamp, BLOCK_CONT);
+        if (ret < 0) {
+            return -EIO;
+        }
     }
 
-    mark_buffer_dirty(bh);
+    bh = bread_block(sb, last_block_num);
+    if (!(sb && bh)) {
+        return -EIO;
+    }
 
-    // forza la scrittura in modo sincrono sul device
-    #ifdef SYNC_WRITE_BACK 
-    if(sync_dirty_buffer(bh) == 0) {
-        AUDIT printk(KERN_INFO "%s: scrittura sincrona avvenuta con successo", MODNAME);
+    // scrittura dei soli byte nuovi e dell'intestazione dell'ultimo blocco (il contenuto precedente viene conservato
+    // per journal_abort_op())
+    bdev_blk = (struct bdev_layout *) bh->b_data;
+    if (journal_save_data(sb, bh, sc) < 0) {
+        brelse(bh);
+        return -EIO;
     }
-    else {
-        printk(KERN_CRIT "%s: scrittura sincrona fallita", MODNAME);
+    write_seqcount_begin(sc);
+    memcpy(bdev_blk->data + len, source, room);
+    bdev_blk->len = len + room;
+    if (new_block >= 0)
+        bdev_blk->cont_block = set_valid(new_block);
+    write_seqcount_end(sc);
+
+    mark_block_dirty(sb, bh);
+
+    if (journal_add_data(sb, bh) < 0) {
+        brelse(bh);
+        return -EIO;
     }
-    #endif
 
     brelse(bh);
 
-    return 0;
+    return new_block;
 }
 
-// questa funzione invalida uno specifico blocco all'interno del dispositivo
-int invalidate_block(struct super_block *global_sb, unsigned int block_num) {
+// restituisce l'indice di un blocco libero oppure -ENOMEM se il device è pieno (write_lock acquisito)
+int get_free_block(struct super_block *sb) {
 
-    struct buffer_head *bh;
+    int i;
     struct bdev_layout *bdev_blk;
 
-    bh = sb_bread(global_sb, block_num);
-    if (!(global_sb && bh)) {
-        return -1;
+    for (i = 0; i < NBLOCKS-2; i++) {
+        bdev_blk = get_block(sb, blk_offset(i));
+        if (bdev_blk == NULL) {
+            return -EIO;
+        }
+
+        if (!get_validity(bdev_blk->next_block)) // cerco un blocco libero (bit di validità = 0)
+            return i;
     }
-    bdev_blk = (struct bdev_layout *) bh->b_data;
 
-    // rendo invalido il blocco target
-    bdev_blk->next_block = set_invalid((unsigned int) -1);
+    return -ENOMEM;
+}
 
-    mark_buffer_dirty(bh);
+// questa funzione invalida uno specifico blocco all'interno del dispositivo (tramite journal)
+int invalidate_block(struct super_block *sb, unsigned int block_num) {
+
+    struct bdev_layout *bdev_blk;
 
-    // forza la scrittura in modo sincrono sul device
-    #ifdef SYNC_WRITE_BACK 
-    if(sync_dirty_buffer(bh) == 0) {
-        AUDIT printk(KERN_INFO "%s: scrittura sincrona avvenuta con successo", MODNAME);
+    bdev_blk = get_block(sb, block_num);
+    if (bdev_blk == NULL) {
+        return -1;
     }
-    else {
-        printk(KERN_CRIT "%s: scrittura sincrona fallita", MODNAME);
+
+    // insieme al messaggio vengono liberati anche i suoi blocchi di continuazione
+    if (release_continuation(sb, bdev_blk->cont_block) < 0) {
+        return -1;
     }
-    #endif
 
-    brelse(bh);
+    if (journal_log_block(sb, block_num, set_invalid((unsigned int) -1)) < 0) {
+        return -1;
+    }
+    FS_INFO(sb)->nr_used--;
+
+    return 0;
+}
+
+// invalida la sequenza di blocchi di continuazione che inizia da cont (campo cont_block del blocco precedente)
+int release_continuation(struct super_block *sb, unsigned int cont) {
+
+    unsigned int hops = 0;
+    unsigned int block_num;
+    struct bdev_layout *bdev_blk;
+
+    while (get_validity(cont) && get_block_num(cont) < NBLOCKS-2 && hops++ < NBLOCKS-2) {
+        block_num = blk_offset(get_block_num(cont));
+        bdev_blk = get_block(sb, block_num);
+        if (bdev_blk == NULL) {
+            return -1;
+        }
+        if (!get_validity(bdev_blk->next_block) || !(bdev_blk->flags & BLOCK_CONT))
+            break;
+        cont = bdev_blk->cont_block;
+
+        if (journal_log_block(sb, block_num, set_invalid((unsigned int) -1)) < 0) {
+            return -1;
+        }
+        FS_INFO(sb)->nr_used--;
+    }
 
     return 0;
 }
 
 // questa funzione restituisce il numero di blocco che punta all'ultimo blocco valido
-unsigned int get_previous_last_valid(struct super_block *global_sb, unsigned int first_valid, unsigned int last_valid) {
+unsigned int get_previous_last_valid(struct super_block *sb, unsigned int first_valid, unsigned int last_valid) {
     
     unsigned int block_num = -1;
     unsigned int curr_block_num = first_valid;
@@ -212,8 +329,8 @@ unsigned int get_previous_last_valid(struct super_block *global_sb, unsigned int
     struct bdev_layout *bdev_blk;
 
     while (cycle < NBLOCKS-2) {
-        bh = sb_bread(global_sb, blk_offset(curr_block_num));
-        if (!(global_sb && bh)) {
+        bh = bread_block(sb, blk_offset(curr_block_num));
+        if (!(sb && bh)) {
             return -1;
         }
         bdev_blk = (struct bdev_layout *) bh->b_data;
@@ -237,19 +354,13 @@ unsigned int get_previous_last_valid(struct super_block *global_sb, unsigned int
     return block_num;
 }
 
-// questa funzione aggiorna tutti i metadati dei blocchi coinvolti nell'invalidazione dell'unico blocco valido
-int invalidate_one(struct super_block *global_sb, unsigned int offset, unsigned int new_first_valid, unsigned int new_last_valid) {
+// questa funzione scollega dalla catena l'unico blocco valido (la sua invalidazione avviene dopo il grace period)
+int invalidate_one(struct super_block *sb, unsigned int chan, unsigned int offset, unsigned int new_first_valid, unsigned int new_last_valid) {
     
     int ret;
 
     // aggiorno il superblocco
-    ret = set_sb_info(global_sb, new_first_valid, new_last_valid);
-    if (ret < 0) {
-        return -1;
-    }
-
-    // invalidazione del blocco (aggiornamento dei suoi metadati)
-    ret = invalidate_block(global_sb, blk_offset(offset));
+    ret = set_sb_info(sb, chan, new_first_valid, new_last_valid);
     if (ret < 0) {
         return -1;
     }
@@ -257,19 +368,13 @@ int invalidate_one(struct super_block *global_sb, unsigned int offset, unsigned
     return 0;
 }
 
-// questa funzione aggiorna tutti i metadati dei blocchi coinvolti nell'invalidazione del blocco in testa
-int invalidate_first(struct super_block *global_sb, unsigned int offset, unsigned int new_first_valid, unsigned int new_last_valid) {
+// questa funzione scollega dalla catena il blocco in testa (la sua invalidazione avviene dopo il grace period)
+int invalidate_first(struct super_block *sb, unsigned int chan, unsigned int offset, unsigned int new_first_valid, unsigned int new_last_valid) {
     
     int ret;
 
     // aggiorno il superblocco
-    ret = set_sb_info(global_sb, new_first_valid, new_last_valid);
-    if (ret < 0) {
-        return -1;
-    }
-
-    // invalidazione del blocco (aggiornamento dei suoi metadati)
-    ret = invalidate_block(global_sb, blk_offset(offset));
+    ret = set_sb_info(sb, chan, new_first_valid, new_last_valid);
     if (ret < 0) {
         return -1;
     }
@@ -277,21 +382,20 @@ int invalidate_first(struct super_block *global_sb, unsigned int offset, unsigne
     return 0;
 }
 
-// questa funzione aggiorna tutti i metadati dei blocchi coinvolti nell'invalidazione di un blocco nel mezzo
-int invalidate_middle(struct super_block *global_sb, unsigned int first_valid, unsigned block_to_invalidate) {
+// questa funzione scollega dalla catena un blocco nel mezzo (la sua invalidazione avviene dopo il grace period)
+int invalidate_middle(struct super_block *sb, unsigned int first_valid, unsigned block_to_invalidate) {
 
     unsigned int curr_block_num = first_valid;
     unsigned int prev_block_num = -1;
     unsigned int next_block_num = -1;
 
     int cycle = 0;
-    int ret;
 
     struct buffer_head *bh;
     struct bdev_layout *bdev_blk;
 
     while (cycle < NBLOCKS-2) {
-        bdev_blk = get_block(global_sb, blk_offset(curr_block_num));
+        bdev_blk = get_block(sb, blk_offset(curr_block_num));
         if (bdev_blk == NULL) {
             return -1;
         }
@@ -308,60 +412,608 @@ int invalidate_middle(struct super_block *global_sb, unsigned int first_valid, u
         cycle++;
     }
 
-    if (update_block_metadata(global_sb, blk_offset(prev_block_num), next_block_num) < 0) {
-        return -1;
-    }
-
-    // invalidazione del blocco (aggiornamento dei suoi metadati)
-    ret = invalidate_block(global_sb, blk_offset(block_to_invalidate));
-    if (ret < 0) {
+    if (update_block_metadata(sb, blk_offset(prev_block_num), next_block_num) < 0) {
         return -1;
     }
 
     return 0; 
 }
 
-// questa funzione aggiorna tutti i metadati dei blocchi coinvolti nell'invalidazione di un blocco alla fine
-int invalidate_last(struct super_block *global_sb, unsigned int offset, unsigned int first_valid, unsigned last_valid, unsigned int next_block_num) {
+// questa funzione scollega dalla catena l'ultimo blocco (la sua invalidazione avviene dopo il grace period)
+int invalidate_last(struct super_block *sb, unsigned int chan, unsigned int offset, unsigned int first_valid, unsigned last_valid, unsigned int next_block_num) {
 
     int ret;
     unsigned int new_last_valid;
 
     // aggiorno i dati che andranno nel superblocco
-    new_last_valid = get_previous_last_valid(global_sb, first_valid, last_valid);
+    new_last_valid = get_previous_last_valid(sb, first_valid, last_valid);
     if (new_last_valid < 0) {
         return -1;
     }
 
     // aggiorno il blocco precedente a quello da eliminare in modo tale da farlo puntare al blocco successivo corretto
-    if (update_block_metadata(global_sb, blk_offset(new_last_valid), next_block_num) < 0) {
+    if (update_block_metadata(sb, blk_offset(new_last_valid), next_block_num) < 0) {
         return -1;
     }
 
     // aggiorno il superblocco
-    ret = set_sb_info(global_sb, first_valid, new_last_valid);
+    ret = set_sb_info(sb, chan, first_valid, new_last_valid);
     if (ret < 0) {
         return -1;
     }
 
-    // invalidazione del blocco (aggiornamento dei suoi metadati)
-    ret = invalidate_block(global_sb, blk_offset(offset));
-    if (ret < 0) {
+    return 0;
+}
+
+// questa funzione scollega dalla catena tutti i blocchi indicati in skip con un'unica visita (la loro invalidazione
+// avviene dopo il grace period): ogni blocco rimasto viene aggiornato solo se cambia il suo successore, mentre i
+// blocchi scollegati continuano a puntare ai loro successori, quindi i lettori concorrenti percorrono sempre una
+// catena valida; restituisce il numero di blocchi scollegati
+int relink_chain(struct super_block *sb, unsigned int chan, unsigned long *skip) {
+
+    int n = 0;
+    unsigned int curr_block_num;
+    unsigned int next_block_num;
+    unsigned int prev_block_num = -1;
+    unsigned int prev_next_num = -1;
+    unsigned int new_first_valid = -1;
+    struct onefilefs_sb_info *sb_disk;
+    struct bdev_layout *bdev_blk;
+
+    sb_disk = get_sb_info(sb);
+    if (sb_disk == NULL) {
         return -1;
     }
 
+    curr_block_num = chan_first_valid(sb_disk, chan);
+    while (curr_block_num < NBLOCKS-2) {
+        bdev_blk = get_block(sb, blk_offset(curr_block_num));
+        if (bdev_blk == NULL) {
+            return -1;
+        }
+        next_block_num = (curr_block_num == chan_last_valid(sb_disk, chan)) ? get_block_num(set_valid(-1)) : get_block_num(bdev_blk->next_block);
+
+        if (test_bit(curr_block_num, skip)) {
+            n++;
+        }
+        else {
+            if (prev_block_num == -1)
+                new_first_valid = curr_block_num;
+            else if (prev_next_num != curr_block_num && update_block_metadata(sb, blk_offset(prev_block_num), curr_block_num) < 0)
+                return -1;
+            prev_block_num = curr_block_num;
+            prev_next_num = next_block_num;
+        }
+
+        curr_block_num = next_block_num;
+    }
+
+    // chiusura della catena sull'ultimo blocco rimasto
+    if (prev_block_num != -1 && prev_next_num != get_block_num(set_valid(-1))) {
+        if (update_block_metadata(sb, blk_offset(prev_block_num), -1) < 0)
+            return -1;
+    }
+
+    if (chan_first_valid(sb_disk, chan) != new_first_valid || chan_last_valid(sb_disk, chan) != prev_block_num) {
+        if (set_sb_info(sb, chan, new_first_valid, prev_block_num) < 0)
+            return -1;
+    }
+
+    return n;
+}
+
+// segue i blocchi di continuazione del messaggio che inizia in block_num marcandoli come raggiunti: un aggancio verso
+// un blocco che non è una continuazione valida (accodamento interrotto da un crash prima del commit) viene rimosso e
+// il messaggio termina all'ultimo blocco integro
+static int check_continuation(struct super_block *sb, unsigned int block_num, unsigned long *reached) {
+
+    unsigned int cont;
+    unsigned int prev_num = block_num;
+    struct buffer_head *bh;
+    struct bdev_layout *bdev_blk;
+
+    bdev_blk = get_block(sb, blk_offset(block_num));
+    if (bdev_blk == NULL) {
+        return -EIO;
+    }
+    cont = bdev_blk->cont_block;
+
+    while (get_validity(cont)) {
+        bdev_blk = NULL;
+        if (get_block_num(cont) < NBLOCKS-2 && !test_bit(get_block_num(cont), reached)) {
+            bdev_blk = get_block(sb, blk_offset(get_block_num(cont)));
+            if (bdev_blk == NULL) {
+                return -EIO;
+            }
+        }
+        if (bdev_blk == NULL || !get_validity(bdev_blk->next_block) || !(bdev_blk->flags & BLOCK_CONT)) {
+            printk(KERN_INFO "%s: continuazione non valida del blocco %u, il messaggio viene troncato\n", MODNAME, prev_num);
+            bh = bread_block(sb, blk_offset(prev_num));
+            if (!bh) {
+                return -EIO;
+            }
+            ((struct bdev_layout *) bh->b_data)->cont_block = 0;
+            mark_block_dirty(sb, bh);
+            brelse(bh);
+            break;
+        }
+        set_bit(get_block_num(cont), reached);
+        prev_num = get_block_num(cont);
+        cont = bdev_blk->cont_block;
+    }
+
     return 0;
 }
 
+// visita la catena del canale chan a partire dal primo blocco valido, caricando l'indice in memoria dei suoi messaggi
+static int check_channel(struct super_block *sb, struct onefilefs_sb_info *sb_disk, unsigned int chan, unsigned long *reached) {
+
+    int ret = 0;
+    uint64_t chain_seq = 0;
+    unsigned int curr_block_num;
+    unsigned int prev_block_num = -1;
+    unsigned int first_valid = chan_first_valid(sb_disk, chan);
+    unsigned int last_valid = chan_last_valid(sb_disk, chan);
+    struct buffer_head *bh;
+    struct bdev_layout *bdev_blk;
+
+    curr_block_num = first_valid;
+    while (curr_block_num < NBLOCKS-2 && !test_bit(curr_block_num, reached)) {
+        bdev_blk = get_block(sb, blk_offset(curr_block_num));
+        if (bdev_blk == NULL) {
+            return -EIO;
+        }
+        if (!block_is_message(bdev_blk))
+            break;
+        set_bit(curr_block_num, reached);
+
+        // le sequenze lungo la catena devono essere crescenti, altrimenti il messaggio riceve una nuova sequenza
+        // (successiva a tutte quelle presenti sul device, quindi unica anche rispetto agli altri canali)
+        if (bdev_blk->seq <= chain_seq) {
+            bh = bread_block(sb, blk_offset(curr_block_num));
+            if (!bh) {
+                return -EIO;
+            }
+            ((struct bdev_layout *) bh->b_data)->seq = ++FS_INFO(sb)->msg_seq;
+            mark_block_dirty(sb, bh);
+            brelse(bh);
+        }
+        chain_seq = bdev_blk->seq;
+
+        // indice in memoria dei messaggi validi
+        FS_INFO(sb)->nr_valid++;
+        FS_INFO(sb)->chan[chan].nr_valid++;
+        FS_INFO(sb)->chan[chan].msg_seq = chain_seq;
+        FS_INFO(sb)->block_seq[curr_block_num] = chain_seq;
+        FS_INFO(sb)->block_time[curr_block_num] = bdev_blk->timestamp;
+        FS_INFO(sb)->block_chan[curr_block_num] = chan;
+        if (index_insert(sb, chain_seq, curr_block_num) < 0) {
+            return -ENOMEM;
+        }
+
+        // blocchi di continuazione del messaggio
+        ret = check_continuation(sb, curr_block_num, reached);
+        if (ret < 0)
+            return ret;
+        ret = message_len(sb, bdev_blk);
+        if (ret < 0) {
+            printk(KERN_CRIT "%s: lunghezza non valida nel messaggio del blocco %u, immagine corrotta\n", MODNAME, curr_block_num);
+            return ret;
+        }
+        FS_INFO(sb)->chan[chan].size += ret + 1;
+        FS_INFO(sb)->chan[chan].mtime = ns_to_timespec64(bdev_blk->timestamp);
+        prev_block_num = curr_block_num;
+        if (curr_block_num == last_valid)
+            break;
+        curr_block_num = get_block_num(bdev_blk->next_block);
+    }
+
+    // chiusura della catena sull'ultimo blocco raggiunto
+    if (prev_block_num == -1) {
+        if (first_valid != -1 || last_valid != -1)
+            ret = set_sb_info(sb, chan, -1, -1);
+    }
+    else {
+        bdev_blk = get_block(sb, blk_offset(prev_block_num));
+        if (bdev_blk == NULL) {
+            return -EIO;
+        }
+        if (get_block_num(bdev_blk->next_block) != get_block_num(set_valid(-1)))
+            ret = update_block_metadata(sb, blk_offset(prev_block_num), -1);
+        if (ret == 0 && last_valid != prev_block_num)
+            ret = set_sb_info(sb, chan, first_valid, prev_block_num);
+    }
+
+    return ret;
+}
+
+// questa funzione riporta la catena dei blocchi validi in uno stato consistente dopo il replay del journal:
+// la catena viene chiusa sull'ultimo blocco valido raggiungibile e i blocchi validi non raggiungibili
+// (scritti prima di un commit mai avvenuto) vengono invalidati
+int check_chain(struct super_block *sb) {
+
+    int i;
+    int ret = 0;
+    unsigned long *reached;
+    struct onefilefs_sb_info *sb_disk;
+    struct bdev_layout *bdev_blk;
+
+    reached = bitmap_zalloc(NBLOCKS-2, GFP_KERNEL);
+    if (!reached) {
+        return -ENOMEM;
+    }
+
+    sb_disk = get_sb_info(sb);
+    if (sb_disk == NULL) {
+        ret = -EIO;
+        goto check_exit;
+    }
+
+    // le letture dei blocchi dati vengono sottomesse tutte insieme (in parallelo sui device del volume)
+    stripe_readahead(sb);
+
+    // le sequenze (anche quelle dei blocchi invalidati) non possono essere riutilizzate
+    for (i = 0; i < NBLOCKS-2; i++) {
+        bdev_blk = get_block(sb, blk_offset(i));
+        if (bdev_blk == NULL) {
+            ret = -EIO;
+            goto check_exit;
+        }
+        FS_INFO(sb)->msg_seq = max(FS_INFO(sb)->msg_seq, bdev_blk->seq);
+        FS_INFO(sb)->msg_time = max(FS_INFO(sb)->msg_time, bdev_blk->timestamp);
+    }
+
+    // visita delle catene dei canali (un blocco raggiunto da un canale non può appartenere a un altro)
+    for (i = 0; ret == 0 && i < NCHANNELS; i++)
+        ret = check_channel(sb, sb_disk, i, reached);
+    if (ret == -ENOMEM)
+        goto check_exit;
+
+    // invalidazione dei blocchi validi non raggiungibili
+    for (i = 0; ret == 0 && i < NBLOCKS-2; i++) {
+        if (test_bit(i, reached))
+            continue;
+        bdev_blk = get_block(sb, blk_offset(i));
+        if (bdev_blk == NULL) {
+            ret = -EIO;
+            break;
+        }
+        if (get_validity(bdev_blk->next_block)) {
+            printk(KERN_INFO "%s: blocco %d valido ma non raggiungibile, viene invalidato\n", MODNAME, i);
+            ret = journal_log_block(sb, blk_offset(i), set_invalid((unsigned int) -1));
+        }
+    }
+
+    FS_INFO(sb)->nr_used = bitmap_weight(reached, NBLOCKS-2);
+
+    if (ret == 0)
+        ret = journal_commit(sb);
+    else
+        ret = -EIO;
+
+check_exit:
+    bitmap_free(reached);
+    return ret;
+}
+
+// questa funzione tiene traccia di un buffer del dispositivo da riportare sul device al prossimo checkpoint: il
+// buffer non viene marcato dirty nella page cache, quindi il writeback del kernel non può scrivere metadati della
+// transazione in costruzione, e resta referenziato fino alla scrittura
+void mark_block_dirty(struct super_block *sb, struct buffer_head *bh) {
+
+    if (bh->b_blocknr < FS_INFO(sb)->nr_dev_blocks && !test_and_set_bit(bh->b_blocknr, FS_INFO(sb)->dirty_map)) {
+        get_bh(bh);
+        atomic_inc(&(FS_INFO(sb)->nr_dirty));
+        writeback_kick(sb);
+    }
+}
+
+// questa funzione rilascia un buffer il cui contenuto in memoria è stato scritto sul device
+void clear_block_dirty(struct super_block *sb, struct buffer_head *bh) {
+
+    if (bh->b_blocknr < FS_INFO(sb)->nr_dev_blocks && test_and_clear_bit(bh->b_blocknr, FS_INFO(sb)->dirty_map)) {
+        atomic_dec(&(FS_INFO(sb)->nr_dirty));
+        put_bh(bh);
+    }
+}
+
+// questa funzione rilascia i buffer rimasti da scrivere dopo un checkpoint fallito (smontaggio)
+void drop_dirty_blocks(struct super_block *sb) {
+
+    unsigned long block_num;
+    struct buffer_head *bh;
+
+    for_each_set_bit(block_num, FS_INFO(sb)->dirty_map, FS_INFO(sb)->nr_dev_blocks) {
+        bh = find_block(sb, block_num);
+        if (!bh)
+            continue;
+        printk(KERN_CRIT "%s: modifiche al blocco %lu non riportate sul device\n", MODNAME, block_num);
+        clear_block_dirty(sb, bh);
+        brelse(bh);
+    }
+}
+
+// questa funzione scrive tutti i buffer dirty del dispositivo con un'unica sottomissione (in ordine crescente
+// di blocco, all'interno di un plug, in parallelo sui device di un volume striped) e un solo flush della cache
+// di ciascun device, compreso l'eventuale mirror (write_lock acquisito); i blocchi con modifiche della
+// transazione in costruzione vengono scritti con i metadati dell'ultimo commit e restano dirty
+int flush_dirty_blocks(struct super_block *sb) {
+
+    int i;
+    int ret = 0;
+    int copies = 0;
+    int written;
+    int nr = 0;
+    int max;
+    unsigned long block_num;
+    struct blk_plug plug;
+    struct buffer_head *bh;
+    struct buffer_head **submitted;
+
+    // buffer sottomessi e relative copie di mirror, attesi dopo la sottomissione di tutti i blocchi
+    max = atomic_read(&(FS_INFO(sb)->nr_dirty));
+    if (max == 0)
+        return mirror_flush(sb, MIRROR_PRIMARY);
+    submitted = kvcalloc(2 * max, sizeof(struct buffer_head *), GFP_KERNEL);
+    if (!submitted) {
+        return -ENOMEM;
+    }
+
+    blk_start_plug(&plug);
+    for_each_set_bit(block_num, FS_INFO(sb)->dirty_map, FS_INFO(sb)->nr_dev_blocks) {
+        // i buffer vengono marcati dirty solo con il write_lock, quindi nr_dirty non può crescere durante la visita
+        if (nr == max) {
+            ret = -EAGAIN;
+            break;
+        }
+        bh = find_block(sb, block_num);
+        if (!bh) {
+            clear_bit(block_num, FS_INFO(sb)->dirty_map);
+            atomic_dec(&(FS_INFO(sb)->nr_dirty));
+            continue;
+        }
+        written = journal_write_frozen(sb, bh);
+        if (written != 0) {
+            if (written < 0)
+                ret = -EIO;
+            brelse(bh);
+            continue;
+        }
+        // il riferimento preso da mark_block_dirty() viene mantenuto fino al completamento della scrittura
+        clear_bit(block_num, FS_INFO(sb)->dirty_map);
+        atomic_dec(&(FS_INFO(sb)->nr_dirty));
+        submitted[2 * nr + 1] = submit_block(sb, bh, REQ_SYNC);
+        submitted[2 * nr] = bh;
+        nr++;
+        brelse(bh);
+    }
+    blk_finish_plug(&plug);
+
+    // attesa del completamento di tutte le scritture sottomesse (con il rilascio del riferimento di mark_block_dirty())
+    for (i = 0; i < nr; i++) {
+        written = mirror_wait(sb, submitted[2 * i], submitted[2 * i + 1]);
+        if (written < 0)
+            ret = -EIO;
+        else
+            copies |= written;
+        put_bh(submitted[2 * i]);
+    }
+    kvfree(submitted);
+
+    // flush delle sole copie che hanno soddisfatto il quorum (con quorum 1 la copia di mirror non rallenta il
+    // flush e viene riallineata al montaggio successivo)
+    if (mirror_flush(sb, copies ? copies : MIRROR_PRIMARY) < 0)
+        ret = -EIO;
+
+    return ret;
+}
+
+// indice in memoria dei messaggi validi: numero di sequenza -> blocco del device (write_lock acquisito)
+int index_insert(struct super_block *sb, uint64_t seq, unsigned int block_num) {
+
+    return xa_err(xa_store(&(FS_INFO(sb)->seq_index), seq, xa_mk_value(block_num), GFP_KERNEL));
+}
+
+// riserva nell'indice la voce del messaggio seq (invisibile alle ricerche): la successiva index_insert() non alloca
+// memoria, quindi non può fallire dopo il collegamento del blocco alla catena
+int index_reserve(struct super_block *sb, uint64_t seq) {
+
+    return xa_reserve(&(FS_INFO(sb)->seq_index), seq, GFP_KERNEL);
+}
+
+void index_remove(struct super_block *sb, uint64_t seq) {
+
+    xa_erase(&(FS_INFO(sb)->seq_index), seq);
+}
+
+// restituisce il blocco del primo messaggio del canale chan con sequenza maggiore di seq (non oltre max_seq),
+// o -1 se non esiste (le sequenze sono comuni a tutti i canali, quindi i messaggi degli altri canali vengono saltati)
+unsigned int index_next(struct super_block *sb, uint64_t seq, uint64_t max_seq, unsigned int chan) {
+
+    void *entry;
+    unsigned long index = seq + 1;
+
+    for (entry = xa_find(&(FS_INFO(sb)->seq_index), &index, max_seq, XA_PRESENT); entry != NULL;
+         entry = xa_find_after(&(FS_INFO(sb)->seq_index), &index, max_seq, XA_PRESENT)) {
+        if (READ_ONCE(FS_INFO(sb)->block_chan[xa_to_value(entry)]) == chan)
+            return xa_to_value(entry);
+    }
+
+    return -1;
+}
+
+// acquisisce il lock del canale a cui appartiene il blocco e ne restituisce l'indice: il canale di un blocco cambia
+// solo quando il blocco viene riallocato, quindi il chiamante deve verificare la validità del blocco (e il suo
+// canale) sotto il write_lock
+int lock_block_channel(struct super_block *sb, unsigned int block_num) {
+
+    unsigned int chan;
+
+    while (1) {
+        chan = READ_ONCE(FS_INFO(sb)->block_chan[block_num]);
+        mutex_lock(&(FS_INFO(sb)->chan[chan].lock));
+        if (READ_ONCE(FS_INFO(sb)->block_chan[block_num]) == chan)
+            return chan;
+        mutex_unlock(&(FS_INFO(sb)->chan[chan].lock));
+    }
+}
+
+// lunghezza del messaggio che inizia nel blocco, compresi i blocchi di continuazione (write_lock acquisito);
+// restituisce -EIO se uno dei blocchi è corrotto
+int message_len(struct super_block *sb, struct bdev_layout *bdev_blk) {
+
+    int ret;
+    int len = 0;
+    unsigned int hops = 0;
+
+    while (bdev_blk != NULL) {
+        ret = block_data_len(bdev_blk);
+        if (ret < 0)
+            return ret;
+        len += ret;
+        if (!get_validity(bdev_blk->cont_block) || get_block_num(bdev_blk->cont_block) >= NBLOCKS-2 || hops++ >= NBLOCKS-2)
+            break;
+        bdev_blk = get_block(sb, blk_offset(get_block_num(bdev_blk->cont_block)));
+    }
+
+    return len;
+}
+
+// aggiorna di delta byte la dimensione del contenuto del canale chan (write_lock acquisito), riportandola insieme
+// all'istante di modifica sull'inode del file del canale se questo è in memoria
+void chan_size_add(struct super_block *sb, unsigned int chan, int64_t delta) {
+
+    struct inode *inode;
+    struct channel_info *ch = &(FS_INFO(sb)->chan[chan]);
+
+    WRITE_ONCE(ch->size, ch->size + delta);
+    ktime_get_real_ts64(&(ch->mtime));
+
+    inode = ilookup(sb, SINGLEFILEFS_CHANNEL_INODE_NUMBER(chan));
+    if (inode == NULL)
+        return;
+    i_size_write(inode, ch->size);
+    inode->i_mtime = inode->i_ctime = ch->mtime;
+    iput(inode);
+}
+
+// copia in dst al più size byte del messaggio che inizia nel blocco a partire da off (seguendo gli eventuali blocchi
+// di continuazione), coerentemente con aggiornamenti in-place e accodamenti concorrenti (il lettore vede il messaggio
+// interamente vecchio o interamente nuovo); restituisce la lunghezza del messaggio e in copied i byte copiati
+// (l'iteratore avanza solo dei byte copiati dall'ultimo tentativo)
+int copy_message_to_iter(struct super_block *sb, unsigned int block_num, struct bdev_layout *bdev_blk, struct iov_iter *dst, size_t off, size_t size, size_t *copied) {
+
+    int len;
+    unsigned int sc;
+    unsigned int cont;
+    unsigned int hops;
+    size_t pos;
+    size_t n = 0;
+    size_t chunk;
+    size_t total;
+    struct bdev_layout *blk;
+
+    size = min(size, iov_iter_count(dst));
+
+    do {
+        // i byte copiati da un tentativo sovrapposto a un aggiornamento vengono sovrascritti dal successivo
+        iov_iter_revert(dst, n);
+        sc = read_seqcount_begin(&(FS_INFO(sb)->block_sc[block_num]));
+        blk = bdev_blk;
+        pos = off;
+        n = 0;
+        total = 0;
+        hops = 0;
+        while (1) {
+            len = block_data_len(blk);
+            if (len < 0)
+                return len;
+            if (pos < len) {
+                chunk = min_t(size_t, size - n, len - pos);
+                if (chunk > 0 && copy_to_iter(blk->data + pos, chunk, dst) != chunk)
+                    return -EFAULT;
+                n += chunk;
+                pos = 0;
+            }
+            else {
+                pos -= len;
+            }
+            total += len;
+
+            cont = READ_ONCE(blk->cont_block);
+            if (!get_validity(cont) || get_block_num(cont) >= NBLOCKS-2 || hops++ >= NBLOCKS-2)
+                break;
+            blk = get_block(sb, blk_offset(get_block_num(cont)));
+            if (blk == NULL)
+                return -EIO;
+        }
+    } while (read_seqcount_retry(&(FS_INFO(sb)->block_sc[block_num]), sc));
+
+    *copied = n;
+
+    return total;
+}
+
+int copy_message_to_user(struct super_block *sb, unsigned int block_num, struct bdev_layout *bdev_blk, char __user *dst, size_t off, size_t size, size_t *copied) {
+
+    struct iovec iov;
+    struct iov_iter iter;
+
+    if (import_single_range(READ, dst, size, &iov, &iter))
+        return -EFAULT;
+
+    return copy_message_to_iter(sb, block_num, bdev_blk, &iter, off, size, copied);
+}
+
+int copy_message_to_kernel(struct super_block *sb, unsigned int block_num, struct bdev_layout *bdev_blk, char *dst, size_t off, size_t size, size_t *copied) {
+
+    struct kvec kvec = { .iov_base = dst, .iov_len = size };
+    struct iov_iter iter;
+
+    iov_iter_kvec(&iter, READ, &kvec, 1, size);
+
+    return copy_message_to_iter(sb, block_num, bdev_blk, &iter, off, size, copied);
+}
+
+// restituisce la sequenza dopo la quale si trovano i messaggi inseriti dopo l'istante time (i tempi sono
+// non decrescenti lungo la sequenza, quindi è la sequenza che precede il primo messaggio più recente di time)
+uint64_t index_seq_before_time(struct super_block *sb, int64_t time, uint64_t max_seq) {
+
+    void *entry;
+    unsigned long index;
+    uint64_t mid;
+    uint64_t lo = 0;
+    uint64_t hi = max_seq + 1;
+
+    // ricerca binaria della più piccola sequenza k il cui primo messaggio successivo (sequenza >= k) è più
+    // recente di time o non esiste: ogni passo è una sola ricerca nell'indice invece di una visita completa
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        index = mid;
+        entry = xa_find(&(FS_INFO(sb)->seq_index), &index, max_seq, XA_PRESENT);
+        if (entry == NULL || READ_ONCE(FS_INFO(sb)->block_time[xa_to_value(entry)]) > time)
+            hi = mid;
+        else
+            lo = index + 1;
+    }
+
+    index = lo;
+    entry = xa_find(&(FS_INFO(sb)->seq_index), &index, max_seq, XA_PRESENT);
+    if (entry == NULL)
+        return max_seq;
+
+    return index - 1;
+}
+
 // for testing
-void print_block_status(struct super_block *global_sb) {
+void print_block_status(struct super_block *sb) {
 
     int cycle = 0;
     struct buffer_head *bh;
     struct bdev_layout *bdev_blk;
 
     while (cycle < NBLOCKS-2) {
-        bh = sb_bread(global_sb, blk_offset(cycle));
+        bh = bread_block(sb, blk_offset(cycle));
         bdev_blk = (struct bdev_layout *) bh->b_data;
         printk(KERN_INFO "%s: %d -> %d | v: %d\n", MODNAME, cycle, get_block_num(bdev_blk->next_block), get_validity(bdev_blk->next_block));
         brelse(bh);
@@ -2,10 +2,18 @@
 #define _UTILS_H
 
 #include <linux/ioctl.h>
+#include <linux/list.h>
 #include <linux/mutex.h>
+#include <linux/refcount.h>
+#include <linux/seqlock.h>
+#include <linux/spinlock.h>
 #include <linux/srcu.h>
+#include <linux/string.h>
 #include <linux/types.h>
 #include <linux/version.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/xarray.h>
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5,15,0)
 #include <linux/atomic.h>
@@ -15,50 +23,400 @@
 
 #include "singlefilefs/singlefilefs.h"
 #include "common_header.h"
+#include "ioctl_header.h"
 
-#define SYNC_WRITE_BACK     // comment this line to disable synchronous writing
+#define SYNC_WRITE_BACK     // comment this line to make asynchronous writing the default mount mode
 
 // BLOCK LEVEL DATA MANAGEMENT SERVICE STUFF
 #define MODNAME "BLOCK-LEVEL-SERVICE"
-#define AUDIT if(1)
+#define LOG if (FS_INFO(sb)->opts.debug >= LOG_OPS)      // messaggi delle singole operazioni (sb: montaggio corrente)
+#define AUDIT if (FS_INFO(sb)->opts.debug >= LOG_AUDIT)  // messaggi di dettaglio (stato dei blocchi, journal, writeback)
 #define DEVICE_NAME "blockleveldev"
 #define DEV_NAME "./mount/the-file"
 #define DEFAULT_BLOCK_SIZE 4096
-#define METADATA_SIZE 4
+#define METADATA_SIZE 32           // next_block, len, seq, timestamp, cont_block e flags (struct bdev_layout)
 #define DATA_SIZE (DEFAULT_BLOCK_SIZE - METADATA_SIZE)
 
 // KERNEL METADATA TO MANAGE MESSAGES
 // Device's block layout
 struct bdev_layout {
     unsigned int next_block; // 1 bit di validità + 31 bit per l'indice del blocco successivo
+    unsigned int len;        // lunghezza del messaggio (0 nei blocchi scritti prima dell'introduzione del campo)
+    uint64_t seq;            // numero di sequenza del messaggio (crescente, mai riutilizzato)
+    int64_t timestamp;       // istante di inserimento del messaggio (ns dall'epoch, non decrescente)
+    unsigned int cont_block; // 1 bit di validità + 31 bit per l'indice del blocco di continuazione del messaggio
+    unsigned int flags;
     char data[DATA_SIZE];
 };
 
-// File system info
+#define BLOCK_CONT 0x1       // blocco di continuazione: fuori dalla catena, raggiungibile solo tramite cont_block
+
+// lunghezza del messaggio contenuto nel blocco; i messaggi vuoti non sono ammessi, quindi una lunghezza nulla o
+// maggiore di DATA_SIZE indica un blocco corrotto (-EIO)
+static inline int block_data_len(struct bdev_layout *bdev_blk) {
+
+    unsigned int len = READ_ONCE(bdev_blk->len);
+
+    if (len == 0 || len > DATA_SIZE)
+        return -EIO;
+
+    return len;
+}
+
+// blocco valido contenente l'inizio di un messaggio (i blocchi di continuazione non sono indirizzabili dagli utenti)
+static inline int block_is_message(struct bdev_layout *bdev_blk) {
+
+    return get_validity(READ_ONCE(bdev_blk->next_block)) && !(READ_ONCE(bdev_blk->flags) & BLOCK_CONT);
+}
+
+// testa e coda della catena dei blocchi validi del canale chan memorizzate nel superblocco
+static inline unsigned int chan_first_valid(struct onefilefs_sb_info *sb_disk, unsigned int chan) {
+
+    return (chan == 0) ? sb_disk->first_valid : sb_disk->channels[chan-1].first_valid;
+}
+
+static inline unsigned int chan_last_valid(struct onefilefs_sb_info *sb_disk, unsigned int chan) {
+
+    return (chan == 0) ? sb_disk->last_valid : sb_disk->channels[chan-1].last_valid;
+}
+
+// JOURNAL
+#define JOURNAL_MAGIC 0x4c4e524a4b4c4201ULL
+#define JOURNAL_COMMIT 0x1                  // il blocco di journal chiude una transazione
+#define JOURNAL_MAX_DATA 32                 // blocchi dati da rendere persistenti prima di un commit
+#define JOURNAL_MAX_SAVED 2                 // blocchi validi modificati in-place da una singola operazione
+#define JOURNAL_MAX_UNDO (2*NBLOCKS + 2*NCHANNELS)  // record annullabili di una singola operazione
+
+// tipi di record del journal
+#define JREC_BLOCK 1    // nuovo valore del campo next_block di un blocco del device
+#define JREC_SB 2       // nuovi valori di first_valid e last_valid di un canale nel superblocco
+
+// record del journal (valori assoluti, quindi la loro riapplicazione è idempotente)
+struct journal_record {
+    unsigned int type;
+    unsigned int block;     // blocco del device (JREC_BLOCK) oppure first_valid (JREC_SB)
+    unsigned int value;     // nuovo next_block (JREC_BLOCK) oppure last_valid (JREC_SB)
+    unsigned int chan;      // canale (JREC_SB)
+};
+
+struct journal_header {
+    uint64_t magic;
+    uint64_t seq;               // numero di sequenza del blocco di journal
+    unsigned int flags;
+    unsigned int nr_records;
+    unsigned int checksum;      // crc32 dell'header (con checksum a zero) e dei record
+    unsigned int padding;
+};
+
+#define JOURNAL_RECORDS ((DEFAULT_BLOCK_SIZE - sizeof(struct journal_header)) / sizeof(struct journal_record))
+
+// Journal block layout
+struct journal_block {
+    struct journal_header header;
+    struct journal_record records[JOURNAL_RECORDS];
+};
+
+// contenuto di un blocco valido prima della sua modifica in-place da parte dell'operazione corrente
+struct journal_saved {
+    struct buffer_head *bh;
+    seqcount_mutex_t *sc;           // seqcount dei lettori del messaggio
+    char *data;
+};
+
+// Journal info (regione circolare di blocchi in coda al device)
+struct journal_info {
+    struct super_block *sb;
+    unsigned int start;             // primo blocco della regione di journal
+    unsigned int nr_blocks;         // numero di blocchi della regione di journal
+    uint64_t next_seq;              // sequenza del prossimo blocco di journal da scrivere
+    uint64_t ckpt_seq;              // primo blocco di journal non ancora riportato in-place
+    uint64_t txn_seq;               // primo blocco di journal della transazione in costruzione
+    struct journal_block *running;  // transazione in costruzione (protetta dal write_lock)
+    struct buffer_head *data_bh[JOURNAL_MAX_DATA];  // blocchi dati della transazione in costruzione
+    unsigned int nr_data;
+    unsigned long *running_map;     // blocchi in-place modificati dai record della transazione in costruzione
+    unsigned int *committed_next;   // campo next_block all'ultimo commit dei blocchi in running_map
+    unsigned int committed_head[NCHANNELS][2];  // testa e coda dei canali all'ultimo commit (superblocco in running_map)
+    uint64_t op_seq;                // numero di sequenza dell'ultima operazione registrata
+    int op_open;                    // l'operazione corrente ha modificato i metadati dopo l'ultimo journal_end_op()
+    uint64_t op_start_seq;          // blocco di journal in costruzione all'inizio dell'operazione corrente
+    unsigned int op_start_nr;       // record della transazione in costruzione all'inizio dell'operazione corrente
+    unsigned int op_nr_used;        // blocchi dati validi all'inizio dell'operazione corrente
+    struct journal_block *op_block; // copia del blocco in costruzione se l'operazione lo scrive senza commit
+    struct journal_record *undo;    // valori precedenti dei campi modificati dai record dell'operazione corrente
+    unsigned int nr_undo;
+    int undo_lost;                  // l'operazione corrente ha superato JOURNAL_MAX_UNDO record
+    unsigned long *op_map;          // blocchi entrati in running_map con l'operazione corrente
+    struct journal_saved saved[JOURNAL_MAX_SAVED];  // blocchi validi modificati in-place dall'operazione corrente
+    unsigned int nr_saved;
+    uint64_t durable_op_seq;        // ultima operazione resa persistente sul device (blocco di commit scritto con REQ_FUA)
+    int error;                      // esito dell'ultimo commit fallito (0 se nessun errore)
+    wait_queue_head_t durable_wq;   // thread in attesa della persistenza di un'operazione
+    struct delayed_work flush_work; // commit in background delle operazioni asincrone
+};
+
+// WRITEBACK
+#define WB_MIN_INTERVAL_MS 10       // intervallo minimo tra due risvegli del thread di writeback
+
+// MOUNT OPTIONS
+// politiche di commit delle operazioni di scrittura (mode=sync|async|group_commit)
+#define COMMIT_SYNC 0       // ogni operazione esegue il proprio commit sincrono prima di ritornare
+#define COMMIT_ASYNC 1      // le operazioni ritornano subito, il commit avviene entro commit= millisecondi
+#define COMMIT_GROUP 2      // le operazioni attendono un commit sincrono condiviso con quelle concorrenti
+
+#ifdef SYNC_WRITE_BACK
+#define DEFAULT_COMMIT_MODE COMMIT_SYNC
+#else
+#define DEFAULT_COMMIT_MODE COMMIT_ASYNC
+#endif
+#define DEFAULT_COMMIT_INTERVAL 10  // ms: finestra di raggruppamento dei commit asincroni
+#define MAX_COMMIT_INTERVAL 60000
+
+// livelli di log (debug=)
+#define LOG_ERR 0       // solo errori
+#define LOG_OPS 1       // invocazione e completamento delle operazioni
+#define LOG_AUDIT 2     // dettaglio
+#define DEFAULT_LOG_LEVEL LOG_OPS
+
+struct mount_options {
+    unsigned int commit_mode;       // COMMIT_SYNC, COMMIT_ASYNC o COMMIT_GROUP
+    unsigned int commit_interval;   // ms
+    unsigned int debug;             // livello di log
+    unsigned int ttl;               // s: età massima dei messaggi (0 = nessun limite)
+    unsigned int max_msgs;          // numero massimo di messaggi validi (0 = nessun limite)
+    char *stripe;                   // device aggiuntivi del volume striped separati da ':' (NULL = nessuno)
+    char *mirror;                   // device di mirror (NULL = nessuno)
+    unsigned int quorum;            // copie scritte con successo necessarie al completamento di una scrittura
+    unsigned int render_cache;      // KB
+    unsigned int read_stage;        // 1 = messaggi brevi della read accumulati nella pagina di staging, 0 = copiati uno alla volta
+};
+
+// STRIPING
+#define MAX_STRIPES 4               // numero massimo di device di un volume (compreso quello del montaggio)
+
+// MIRROR
+#define MIRROR_PRIMARY 0x1          // copia scritta sul device del volume
+#define MIRROR_COPY 0x2             // copia scritta sul device di mirror
+
+// RENDER CACHE
+#define DEFAULT_RENDER_CACHE 1024   // KB: limite di memoria della copia renderizzata di ciascun canale (0 = disabilitata)
+
+// RETENTION
+#define RETENTION_BATCH 64          // messaggi eliminati con un unico commit
+#define RETENTION_INTERVAL_MS 1000  // intervallo tra due esecuzioni del worker di retention
+
+// messaggio della copia renderizzata di un canale
+struct render_entry {
+    uint64_t seq;                   // numero di sequenza del messaggio
+    size_t off;                     // offset del messaggio nel contenuto renderizzato
+};
+
+// memoria di una copia renderizzata, condivisa con i lettori che la stanno copiando nel buffer utente
+struct render_snap {
+    refcount_t ref;
+    char *buf;                      // messaggi seguiti dal fine riga
+    struct render_entry *entries;   // messaggi della copia in ordine di sequenza
+};
+
+// Copia renderizzata del contenuto di un canale (render.c)
+struct render_cache {
+    struct mutex lock;              // serializza l'aggiornamento della copia e l'acquisizione dei riferimenti
+    struct render_snap *snap;       // NULL se non ancora allocata
+    size_t cap;
+    size_t size;
+    unsigned int nr;
+    unsigned int last_block;        // blocco dell'ultimo messaggio renderizzato
+    unsigned int full;              // contenuto più grande di cap (fino alla prossima ricostruzione)
+    uint64_t gen;                   // generazione del canale riflessa dalla copia
+    uint64_t rewrite_gen;
+};
+
+// Stato in memoria di un canale (log indipendente con la propria catena di blocchi validi)
+struct channel_info {
+    struct mutex lock;              // serializza le operazioni di scrittura sul canale
+    wait_queue_head_t read_wq;      // lettori del canale in attesa di nuovi messaggi
+    uint64_t msg_seq;               // sequenza dell'ultimo messaggio collegato alla catena del canale
+    unsigned int nr_valid;          // numero di messaggi validi del canale (protetto dal lock del canale)
+    uint64_t gen;                   // generazione del contenuto: incrementata da ogni put, invalidazione o aggiornamento
+    uint64_t rewrite_gen;           // generazione delle sole modifiche diverse da un accodamento
+    struct render_cache render;
+    uint64_t size;                  // byte del contenuto del file del canale (messaggi validi e fine riga)
+    struct timespec64 mtime;        // istante dell'ultima modifica del contenuto
+};
+
+// File system info (una per montaggio, in sb->s_fs_info)
 struct filesystem_info {
+    struct super_block *sb;
+    struct list_head mounts;    // elemento della lista dei montaggi attivi
     unsigned int mounted;       // indica se il file system è montato o meno
     atomic_t usage;             // tiene traccia del numero di thread che stanno correntemente utilizzando il file system
-    struct mutex write_lock;    // utilizzato per sincronizzare gli scrittori tra loro
+    struct mutex write_lock;    // sincronizza gli scrittori sulle strutture condivise tra i canali (blocchi liberi, superblocco, journal)
     struct srcu_struct srcu;    // struttura dati a supporto delle sleepable RCU 
+    struct journal_info journal;
+    sector_t nr_dev_blocks;     // numero di blocchi del device (dati, superblocco, inode e journal)
+    unsigned long *dirty_map;   // blocchi del device modificati in memoria e non ancora scritti (buffer referenziati)
+    atomic_t nr_dirty;          // numero di bit impostati in dirty_map
+    struct task_struct *wb_task;    // thread di writeback
+    wait_queue_head_t wb_wq;        // coda su cui attende il thread di writeback
+    struct mount_options opts;      // opzioni del montaggio corrente
+    uint64_t *block_seq;            // numero di sequenza del messaggio contenuto in ciascun blocco dati
+    int64_t *block_time;            // istante di inserimento del messaggio contenuto in ciascun blocco dati
+    uint64_t msg_seq;               // sequenza dell'ultimo messaggio collegato alla catena dei blocchi validi
+    int64_t msg_time;               // istante di inserimento dell'ultimo messaggio
+    struct xarray seq_index;        // indice dei messaggi validi (sequenza -> blocco)
+    unsigned int nr_valid;          // numero di messaggi validi (protetto dal write_lock)
+    unsigned int nr_used;           // numero di blocchi dati validi, compresi quelli di continuazione (protetto dal write_lock)
+    unsigned int *block_chan;       // canale del messaggio contenuto in ciascun blocco dati
+    struct channel_info chan[NCHANNELS];
+    seqcount_mutex_t block_sc[NBLOCKS-2];  // aggiornamenti in-place dei messaggi (scrittori serializzati dal write_lock)
+    struct delayed_work retention_work; // eliminazione periodica dei messaggi scaduti
+    struct list_head notify_list;   // code degli fd di notifica aperti
+    spinlock_t notify_lock;         // protegge notify_list
+    struct block_device *stripe_bdev[MAX_STRIPES];  // device del volume (stripe_bdev[0] è quello del montaggio)
+    unsigned int nr_stripes;        // numero di device del volume
+    struct block_device *mirror_bdev;   // device di mirror (NULL se il volume non è replicato)
+    atomic_t mirror_reads[2];       // letture in corso sul device del volume e sul mirror
+};
+
+#define FS_INFO(sb) ((struct filesystem_info *) (sb)->s_fs_info)
+
+// Anelli di sottomissione e completamento di un file aperto (ring.c), mappati nello spazio utente
+struct blocklevel_ring {
+    struct mutex lock;              // serializza i doorbell sullo stesso file aperto
+    void *mem;                      // area condivisa (vmalloc_user)
+    size_t size;
+    unsigned int mask;              // entries - 1
+    unsigned int sq_head;           // prossima voce di sottomissione da consumare
+    unsigned int cq_tail;           // prossima voce di completamento da produrre
+    struct ring_header *hdr;
+    struct ring_sqe *sqes;
+    struct ring_cqe *cqes;
+    char *sq_data;                  // slot delle voci di sottomissione
+    char *cq_data;                  // slot delle voci di completamento
+    unsigned long *put_map;         // voci di completamento delle put del batch in corso (per indice nell'anello)
+};
+
+// Stato di un file aperto su the-file o sul file di un canale (file->private_data)
+struct onefilefs_file {
+    struct super_block *sb;         // montaggio su cui opera il file
+    unsigned int chan;              // canale letto tramite il file
+    uint64_t seq;                   // ultimo messaggio consegnato interamente
+    uint64_t partial_seq;           // messaggio consegnato solo in parte (0 se nessuno)
+    unsigned int partial_off;       // byte già consegnati di partial_seq
+    unsigned int follow;            // la read attende nuovi messaggi invece di restituire EOF
+    struct mutex cur_lock;          // serializza le ioctl del cursore sullo stesso file aperto
+    uint64_t cur_seq;               // cursore: ultimo messaggio restituito da IOCTL_CURSOR_FETCH
+    unsigned int cur_block;         // cursore: blocco che conteneva cur_seq (-1 se sconosciuto)
+    struct blocklevel_ring *ring;   // anelli di sottomissione e completamento (NULL se non allocati)
+    struct mutex read_lock;         // serializza le read sullo stesso file aperto (posizione e pagina di staging)
+    char *stage;                    // pagina di staging dei messaggi brevi (allocata alla prima read)
 };
 
-// Shared variables
-extern struct super_block *global_sb;       // super block variable accessible by syscalls
-extern struct filesystem_info fs_info;
+// Module parameters (blocklevel.c)
+extern unsigned int wb_interval_ms;
+extern unsigned int wb_dirty_threshold;
 
 // Prototypes
 struct onefilefs_sb_info* get_sb_info(struct super_block *);
 struct bdev_layout* get_block(struct super_block *, unsigned int);
-int set_sb_info(struct super_block *, unsigned int, unsigned int);
+int set_sb_info(struct super_block *, unsigned int, unsigned int, unsigned int);
 int set_block_metadata_valid(struct super_block *, unsigned int, unsigned int);
 int update_block_metadata(struct super_block *, unsigned int, unsigned int);
-int set_block_data(struct super_block *, unsigned int, char *, size_t);
+int set_block_data(struct super_block *, unsigned int, char *, size_t, uint64_t, int64_t, unsigned int);
+int update_block_data(struct super_block *, unsigned int, char *, size_t, unsigned int *);
+int append_block_data(struct super_block *, unsigned int, char *, size_t);
+int get_free_block(struct super_block *);
+int release_continuation(struct super_block *, unsigned int);
 int invalidate_block(struct super_block *, unsigned int);
 unsigned int get_previous_last_valid(struct super_block *, unsigned int, unsigned int);
-int invalidate_one(struct super_block *, unsigned int, unsigned int, unsigned int);
-int invalidate_first(struct super_block *, unsigned int, unsigned int, unsigned int);
+int invalidate_one(struct super_block *, unsigned int, unsigned int, unsigned int, unsigned int);
+int invalidate_first(struct super_block *, unsigned int, unsigned int, unsigned int, unsigned int);
 int invalidate_middle(struct super_block *, unsigned int, unsigned int);
-int invalidate_last(struct super_block *, unsigned int, unsigned int, unsigned int, unsigned int);
+int invalidate_last(struct super_block *, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int);
+int relink_chain(struct super_block *, unsigned int, unsigned long *);
+int check_chain(struct super_block *);
+void mark_block_dirty(struct super_block *, struct buffer_head *);
+void clear_block_dirty(struct super_block *, struct buffer_head *);
+void drop_dirty_blocks(struct super_block *);
+int flush_dirty_blocks(struct super_block *);
+int index_insert(struct super_block *, uint64_t, unsigned int);
+int index_reserve(struct super_block *, uint64_t);
+void index_remove(struct super_block *, uint64_t);
+unsigned int index_next(struct super_block *, uint64_t, uint64_t, unsigned int);
+int lock_block_channel(struct super_block *, unsigned int);
+int message_len(struct super_block *, struct bdev_layout *);
+void chan_size_add(struct super_block *, unsigned int, int64_t);
+struct iov_iter;
+int copy_message_to_iter(struct super_block *, unsigned int, struct bdev_layout *, struct iov_iter *, size_t, size_t, size_t *);
+int copy_message_to_user(struct super_block *, unsigned int, struct bdev_layout *, char __user *, size_t, size_t, size_t *);
+int copy_message_to_kernel(struct super_block *, unsigned int, struct bdev_layout *, char *, size_t, size_t, size_t *);
+uint64_t index_seq_before_time(struct super_block *, int64_t, uint64_t);
+// journal.c
+int journal_load(struct super_block *);
+void journal_unload(struct super_block *);
+int journal_log_block(struct super_block *, unsigned int, unsigned int);
+int journal_log_sb(struct super_block *, unsigned int, unsigned int, unsigned int);
+int journal_add_data(struct super_block *, struct buffer_head *);
+int journal_save_data(struct super_block *, struct buffer_head *, seqcount_mutex_t *);
+uint64_t journal_end_op(struct super_block *);
+int journal_abort_op(struct super_block *);
+int journal_commit(struct super_block *);
+int journal_commit_async(struct super_block *);
+int journal_commit_mode(struct super_block *, unsigned int);
+int journal_wait_durable(struct super_block *, uint64_t);
+int journal_sync(struct super_block *);
+int journal_checkpoint(struct super_block *);
+int journal_write_frozen(struct super_block *, struct buffer_head *);
+// writeback.c
+int writeback_start(struct super_block *);
+void writeback_stop(struct super_block *);
+void writeback_kick(struct super_block *);
+// retention.c
+void retention_work(struct work_struct *);
+void retention_start(struct super_block *);
+void retention_stop(struct super_block *);
+// notify.c
+int notify_open(struct super_block *);
+void notify_event(struct super_block *, unsigned int, unsigned int, uint64_t);
+// blocklevelsyscall.c
+int put_data_user(struct super_block *, unsigned int, char *, size_t, int, uint64_t *);
+int put_data_kernel(struct super_block *, unsigned int, char *, size_t, int, uint64_t *);
+int get_data_user(struct super_block *, int, char __user *, size_t);
+int get_data_kernel(struct super_block *, int, char *, size_t);
+int invalidate_data_user(struct super_block *, int, uint64_t *);
+int invalidate_data_bulk(struct super_block *, unsigned int, int, int __user *, unsigned int, uint64_t, uint64_t, uint64_t *);
+int update_data_user(struct super_block *, int, char __user *, size_t, uint64_t *);
+int append_data_user(struct super_block *, int, char __user *, size_t, uint64_t *);
+// stripe.c
+struct block_device *block_bdev(struct super_block *, unsigned int);
+struct buffer_head *bread_block(struct super_block *, unsigned int);
+struct buffer_head *find_block(struct super_block *, unsigned int);
+int stripe_open(struct super_block *);
+void stripe_close(struct super_block *);
+void stripe_readahead(struct super_block *);
+// mirror.c
+struct buffer_head *mirror_write(struct super_block *, struct buffer_head *, int);
+int mirror_wait(struct super_block *, struct buffer_head *, struct buffer_head *);
+int mirror_flush(struct super_block *, int);
+struct buffer_head *submit_block(struct super_block *, struct buffer_head *, int);
+int sync_block(struct super_block *, struct buffer_head *, int);
+struct buffer_head *mirror_read(struct super_block *, struct block_device *, unsigned int);
+int mirror_open(struct super_block *);
+void mirror_close(struct super_block *);
+// ring.c
+struct vm_area_struct;
+int ring_setup(struct onefilefs_file *, struct ring_setup_args *);
+void ring_free(struct blocklevel_ring *);
+int ring_mmap(struct blocklevel_ring *, struct vm_area_struct *);
+int ring_enter(struct super_block *, unsigned int, struct blocklevel_ring *);
+// snapshot.c
+int snapshot_mmap(struct super_block *, unsigned int, struct vm_area_struct *);
+// render.c
+void render_bump(struct super_block *, unsigned int, int);
+ssize_t render_read(struct super_block *, struct onefilefs_file *, struct iov_iter *, uint64_t);
+void render_free(struct super_block *);
+// singlefilefs_src.c
+struct super_block *singlefilefs_get_default(void);
 // for testing
 void print_block_status(struct super_block *);
 
@@ -0,0 +1,93 @@
+#include <linux/buffer_head.h>
+#include <linux/fs.h>
+#include <linux/jiffies.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+
+#include "utils_header.h"
+
+/*
+    Thread di writeback del modulo: si risveglia ogni wb_interval_ms millisecondi oppure quando
+    il numero di blocchi dirty raggiunge wb_dirty_threshold, effettua il checkpoint del journal e
+    riporta sul device tutti i buffer dirty (blocchi dati, metadati e superblocco) in ordine
+    crescente di blocco all'interno di un unico plug, in modo che il block layer li unisca in
+    poche richieste sequenziali di grandi dimensioni.
+*/
+
+// controlla se il thread di writeback ha del lavoro da svolgere
+static int writeback_pending(struct super_block *sb) {
+
+    unsigned int threshold = READ_ONCE(wb_dirty_threshold);
+
+    return threshold != 0 && atomic_read(&(FS_INFO(sb)->nr_dirty)) >= threshold;
+}
+
+static int writeback_thread(void *data) {
+
+    int ret;
+    unsigned int interval;
+    struct super_block *sb = data;
+    struct journal_info *j = &(FS_INFO(sb)->journal);
+
+    printk("%s: [writeback] - thread di writeback avviato sul device %s\n", MODNAME, sb->s_id);
+
+    while (!kthread_should_stop()) {
+        interval = max_t(unsigned int, READ_ONCE(wb_interval_ms), WB_MIN_INTERVAL_MS);
+        wait_event_interruptible_timeout(FS_INFO(sb)->wb_wq, kthread_should_stop() || writeback_pending(sb), msecs_to_jiffies(interval));
+
+        if (kthread_should_stop())
+            break;
+
+        // nulla da scrivere e journal già riportato in-place
+        if (atomic_read(&(FS_INFO(sb)->nr_dirty)) == 0 && READ_ONCE(j->ckpt_seq) == READ_ONCE(j->next_seq))
+            continue;
+
+        mutex_lock(&(FS_INFO(sb)->write_lock));
+        ret = journal_checkpoint(sb);
+        mutex_unlock(&(FS_INFO(sb)->write_lock));
+
+        if (ret < 0)
+            printk(KERN_CRIT "%s: [writeback] - checkpoint fallito (ret=%d)\n", MODNAME, ret);
+        else
+            AUDIT printk(KERN_INFO "%s: [writeback] - checkpoint completato (seq=%llu)\n", MODNAME, j->ckpt_seq);
+    }
+
+    printk("%s: [writeback] - thread di writeback terminato\n", MODNAME);
+
+    return 0;
+}
+
+// risveglia il thread di writeback se la soglia di blocchi dirty è stata raggiunta
+void writeback_kick(struct super_block *sb) {
+
+    if (writeback_pending(sb))
+        wake_up_interruptible(&(FS_INFO(sb)->wb_wq));
+}
+
+// avvio del thread di writeback al montaggio
+int writeback_start(struct super_block *sb) {
+
+    struct task_struct *task;
+
+    task = kthread_run(writeback_thread, sb, "blocklevel-wb/%s", sb->s_id);
+    if (IS_ERR(task)) {
+        printk(KERN_CRIT "%s: [writeback] - impossibile avviare il thread di writeback\n", MODNAME);
+        FS_INFO(sb)->wb_task = NULL;
+        return PTR_ERR(task);
+    }
+    FS_INFO(sb)->wb_task = task;
+
+    return 0;
+}
+
+// arresto del thread di writeback allo smontaggio (il checkpoint finale è a carico di journal_unload)
+void writeback_stop(struct super_block *sb) {
+
+    if (!FS_INFO(sb)->wb_task)
+        return;
+
+    kthread_stop(FS_INFO(sb)->wb_task);
+    FS_INFO(sb)->wb_task = NULL;
+}